@@ -0,0 +1,109 @@
+/************************************************
+ *                   bench.c                    *
+ ************************************************
+ * Shared pieces of the benchmark drivers:      *
+ * collecting samples and printing them as one  *
+ * JSON object per line with percentiles        *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static int cmp_double (const void *, const void *);
+static double percentile (const samples *, double);
+
+/**
+ * starts an empty set of samples
+ */
+void samples_init (samples *s)
+{
+    s->v = NULL;
+    s->n = 0;
+    s->cap = 0;
+}
+
+/**
+ * adds one measurement
+ */
+void samples_add (samples *s, double x)
+{
+    if (s->n == s->cap) {
+        int cap = s->cap ? s->cap * 2 : 64;
+        double *v = realloc(s->v, sizeof(double) * cap);
+        if (v == NULL) {
+            perror("realloc failed in samples_add");
+            exit(-1);
+        }
+        s->v = v;
+        s->cap = cap;
+    }
+    s->v[s->n++] = x;
+}
+
+/**
+ * frees the samples
+ */
+void samples_free (samples *s)
+{
+    free(s->v);
+    samples_init(s);
+}
+
+/**
+ * monotonic time in seconds
+ */
+double bench_now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * prints a JSON line for one benchmark case with the spread of its
+ * samples. The samples get sorted
+ */
+void bench_report (const char *bench, const char *name, const char *unit,
+    samples *s)
+{
+    if (s->n == 0) {
+        return;
+    }
+    qsort(s->v, s->n, sizeof(double), cmp_double);
+    double sum = 0;
+    for (int i = 0; i < s->n; i++) {
+        sum += s->v[i];
+    }
+    printf("{\"bench\":\"%s\",\"case\":\"%s\",\"unit\":\"%s\",\"n\":%d,"
+        "\"min\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f,"
+        "\"mean\":%.3f}\n", bench, name, unit, s->n, s->v[0],
+        percentile(s, 50), percentile(s, 90), percentile(s, 99),
+        s->v[s->n - 1], sum / s->n);
+    fflush(stdout);
+}
+
+/**
+ * qsort order for doubles
+ */
+static int cmp_double (const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * nearest rank percentile of sorted samples
+ */
+static double percentile (const samples *s, double p)
+{
+    int rank = (int)(p / 100 * s->n + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return s->v[rank - 1];
+}
@@ -0,0 +1,20 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+typedef struct {
+    double *v;
+    int n;
+    int cap;
+} samples;
+
+void samples_init (samples *);
+
+void samples_add (samples *, double);
+
+void samples_free (samples *);
+
+double bench_now ();
+
+void bench_report (const char *, const char *, const char *, samples *);
+
+#endif
@@ -0,0 +1,138 @@
+/************************************************
+ *                exec_bench.c                  *
+ ************************************************
+ * Measures execute(): how long launching and   *
+ * reaping `true` takes with posix_spawn and    *
+ * with fork, and how many bytes per second go  *
+ * through pipelines of N cats                  *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "bench.h"
+#include "../includes/executor.h"
+#include "../includes/tokenizer.h"
+#include "../includes/pipeline.h"
+#include "../includes/vars.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#define WARMUP 20
+#define LAUNCHES 500
+#define DATA_SIZE (64 * 1024 * 1024)
+#define PIPE_RUNS 5
+#define MAX_STAGES 8
+
+static void parse (ListHandler *, const char *, pipeline *);
+static void make_data (const char *);
+
+int main (int argc, char **argv)
+{
+    signal(SIGTTOU, SIG_IGN); // like the shell, to hand the terminal back
+    ListHandler tlist;
+    init_tok_list(&tlist);
+    pipeline pl;
+
+    /* launch latency of a command that does nothing. true is a builtin,
+     * so it is run by path to launch the real one */
+    const char *launchers[] = { "spawn", "fork" };
+    const char *names[] = { "true", "true | true" };
+    const char *lines[] = { "/bin/true", "/bin/true | /bin/true" };
+    for (int l = 0; l < 2; l++) {
+        for (int m = 0; m < 2; m++) {
+            var_set("MYCLI_LAUNCH", launchers[m], true);
+            parse(&tlist, lines[l], &pl);
+            samples s;
+            samples_init(&s);
+            for (int r = 0; r < WARMUP + LAUNCHES; r++) {
+                double start = bench_now();
+                execute(&pl);
+                if (r >= WARMUP) {
+                    samples_add(&s, (bench_now() - start) * 1e6);
+                }
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "%s/%s", names[l], launchers[m]);
+            bench_report("launch", name, "us", &s);
+            samples_free(&s);
+            free_tok_list(&tlist);
+        }
+    }
+    var_unset("MYCLI_LAUNCH");
+
+    /* throughput of cat file | cat | ... > /dev/null */
+    char data[] = "/tmp/mycli-pipe-bench-XXXXXX";
+    int fd = mkstemp(data);
+    if (fd < 0) {
+        perror("mkstemp failed");
+        return 1;
+    }
+    close(fd);
+    make_data(data);
+    for (int stages = 1; stages <= MAX_STAGES; stages *= 2) {
+        char line[64 + MAX_STAGES * 8];
+        char *end = line + sprintf(line, "cat %s", data);
+        for (int i = 1; i < stages; i++) {
+            end += sprintf(end, " | cat");
+        }
+        sprintf(end, " > /dev/null");
+        parse(&tlist, line, &pl);
+        samples s;
+        samples_init(&s);
+        for (int r = 0; r < PIPE_RUNS; r++) {
+            double start = bench_now();
+            execute(&pl);
+            samples_add(&s, DATA_SIZE / (bench_now() - start) / 1e6);
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "cat-x%d", stages);
+        bench_report("pipeline", name, "MB/s", &s);
+        samples_free(&s);
+        free_tok_list(&tlist);
+    }
+    unlink(data);
+
+    destroy_tok_list(&tlist);
+    return 0;
+}
+
+/**
+ * tokenizes a command line and splits it into a pipeline, the way the
+ * shell would before running it
+ */
+static void parse (ListHandler *tlist, const char *cmd, pipeline *pl)
+{
+    size_t len = strlen(cmd);
+    char line[len + 2];
+    memcpy(line, cmd, len);
+    line[len] = '\n';
+    line[len + 1] = '\0';
+    tokenize(tlist, line, len + 1);
+    build_pipeline(*tlist, pl);
+}
+
+/**
+ * writes DATA_SIZE bytes to file
+ */
+static void make_data (const char *file)
+{
+    static char chunk[1 << 20];
+    memset(chunk, 'x', sizeof(chunk));
+    int fd = open(file, O_WRONLY | O_TRUNC);
+    if (fd < 0) {
+        perror(file);
+        exit(1);
+    }
+    for (size_t n = 0; n < DATA_SIZE; n += sizeof(chunk)) {
+        if (write(fd, chunk, sizeof(chunk)) < 0) {
+            perror(file);
+            exit(1);
+        }
+    }
+    close(fd);
+}
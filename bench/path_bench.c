@@ -0,0 +1,124 @@
+/************************************************
+ *                path_bench.c                  *
+ ************************************************
+ * Measures the PATH cache against a generated  *
+ * PATH holding tens of thousands of commands:  *
+ * rebuild time and hit and miss lookup latency *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "bench.h"
+#include "../includes/pathcache.h"
+#include "../includes/vars.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define DIR_CT 40
+#define FILES_PER_DIR 1000
+#define REBUILDS 10
+#define LOOKUP_SAMPLES 200
+#define LOOKUPS_PER_SAMPLE 1000
+
+static void make_tree (const char *);
+static void remove_tree (const char *);
+
+int main (int argc, char **argv)
+{
+    char root[] = "/tmp/mycli-path-bench-XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        perror("mkdtemp failed");
+        return 1;
+    }
+    make_tree(root);
+
+    /* PATH of every generated directory */
+    char *path = malloc(DIR_CT * (strlen(root) + 16));
+    if (path == NULL) {
+        perror("malloc failed");
+        return 1;
+    }
+    char *end = path;
+    for (int d = 0; d < DIR_CT; d++) {
+        end += sprintf(end, "%s%s/d%d", d ? ":" : "", root, d);
+    }
+    var_set("PATH", path, true);
+
+    samples s;
+    samples_init(&s);
+    for (int r = 0; r < REBUILDS; r++) {
+        path_cache_invalidate();
+        double start = bench_now();
+        path_lookup("cmd-0-0");
+        samples_add(&s, (bench_now() - start) * 1e3);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "rebuild/%d-entries", DIR_CT * FILES_PER_DIR);
+    bench_report("path", name, "ms", &s);
+    samples_free(&s);
+
+    const char *kinds[] = { "lookup-hit", "lookup-miss" };
+    for (int k = 0; k < 2; k++) {
+        samples_init(&s);
+        unsigned int seed = 1;
+        for (int r = 0; r < LOOKUP_SAMPLES; r++) {
+            char cmd[64];
+            double start = bench_now();
+            for (int i = 0; i < LOOKUPS_PER_SAMPLE; i++) {
+                seed = seed * 1103515245 + 12345;
+                int d = (seed >> 8) % DIR_CT;
+                int f = (seed >> 16) % FILES_PER_DIR;
+                snprintf(cmd, sizeof(cmd), k ? "nope-%d-%d" : "cmd-%d-%d", d, f);
+                path_lookup(cmd);
+            }
+            samples_add(&s, (bench_now() - start) * 1e9 / LOOKUPS_PER_SAMPLE);
+        }
+        bench_report("path", kinds[k], "ns", &s);
+        samples_free(&s);
+    }
+
+    remove_tree(root);
+    free(path);
+    return 0;
+}
+
+/**
+ * makes DIR_CT directories of FILES_PER_DIR empty executables in root
+ */
+static void make_tree (const char *root)
+{
+    char file[256];
+    for (int d = 0; d < DIR_CT; d++) {
+        snprintf(file, sizeof(file), "%s/d%d", root, d);
+        mkdir(file, S_IRWXU);
+        for (int f = 0; f < FILES_PER_DIR; f++) {
+            snprintf(file, sizeof(file), "%s/d%d/cmd-%d-%d", root, d, d, f);
+            int fd = open(file, O_WRONLY | O_CREAT, S_IRWXU);
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+}
+
+/**
+ * removes what make_tree made
+ */
+static void remove_tree (const char *root)
+{
+    char file[256];
+    for (int d = 0; d < DIR_CT; d++) {
+        for (int f = 0; f < FILES_PER_DIR; f++) {
+            snprintf(file, sizeof(file), "%s/d%d/cmd-%d-%d", root, d, d, f);
+            unlink(file);
+        }
+        snprintf(file, sizeof(file), "%s/d%d", root, d);
+        rmdir(file);
+    }
+    rmdir(root);
+}
@@ -0,0 +1,156 @@
+/************************************************
+ *              tokenizer_bench.c               *
+ ************************************************
+ * Measures tokenize() throughput on synthetic  *
+ * inputs with each scan implementation         *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "bench.h"
+#include "../includes/tokenizer.h"
+#include "../includes/scan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT_SIZE (8 * 1024 * 1024)
+#define RUNS 15
+
+typedef struct {
+    const char *name;
+    char *buf; // one or more lines, each ending in \n
+    size_t len;
+} input;
+
+static char* make_input (const char *, size_t *);
+static size_t tokenize_all (ListHandler *, char *, size_t);
+
+int main (int argc, char **argv)
+{
+    input inputs[] = {
+        { "short-commands", NULL, 0 },
+        { "long-quoted", NULL, 0 },
+        { "many-pipes", NULL, 0 },
+        { "plain-arg", NULL, 0 },
+        { "short-words", NULL, 0 },
+    };
+    int input_ct = sizeof(inputs) / sizeof(inputs[0]);
+    for (int i = 0; i < input_ct; i++) {
+        inputs[i].buf = make_input(inputs[i].name, &inputs[i].len);
+    }
+
+    scan_mode modes[] = { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+    ListHandler tlist;
+    init_tok_list(&tlist);
+
+    for (int i = 0; i < input_ct; i++) {
+        for (int m = 0; m < 3; m++) {
+            if (scan_set_mode(modes[m]) != modes[m]) {
+                continue; // cpu can't run it
+            }
+            samples s;
+            samples_init(&s);
+            for (int r = 0; r < RUNS; r++) {
+                double start = bench_now();
+                tokenize_all(&tlist, inputs[i].buf, inputs[i].len);
+                double secs = bench_now() - start;
+                samples_add(&s, inputs[i].len / secs / 1e6);
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "%s/%s", inputs[i].name,
+                scan_mode_name(modes[m]));
+            bench_report("tokenize", name, "MB/s", &s);
+            samples_free(&s);
+        }
+    }
+
+    destroy_tok_list(&tlist);
+    for (int i = 0; i < input_ct; i++) {
+        free(inputs[i].buf);
+    }
+    return 0;
+}
+
+/**
+ * tokenizes every line of buf, like the shell would one after another.
+ * Returns how many tokens there were
+ */
+static size_t tokenize_all (ListHandler *tlist, char *buf, size_t len)
+{
+    size_t tokens = 0;
+    char *line = buf;
+    char *end = buf + len;
+    while (line < end) {
+        char *nl = memchr(line, '\n', end - line);
+        tokenize(tlist, line, nl + 1 - line);
+        tokens += tlist->count;
+        free_tok_list(tlist);
+        line = nl + 1;
+    }
+    return tokens;
+}
+
+/**
+ * builds about INPUT_SIZE bytes of input of the named kind
+ */
+static char* make_input (const char *kind, size_t *len)
+{
+    static const char b64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const char *short_cmds[] = {
+        "ls -la /tmp\n",
+        "grep -n foo bar.txt > out.txt\n",
+        "cat a.txt | sort | uniq -c >> counts\n",
+        "echo \"hello world\" 'and more'\n",
+        "make -j4 all\n",
+    };
+    char *buf = malloc(INPUT_SIZE + 1);
+    if (buf == NULL) {
+        perror("malloc failed in make_input");
+        exit(-1);
+    }
+    size_t n = 0;
+    if (!strcmp(kind, "short-commands")) {
+        for (int k = 0; ; k++) {
+            const char *c = short_cmds[k % 5];
+            size_t cl = strlen(c);
+            if (n + cl > INPUT_SIZE) {
+                break;
+            }
+            memcpy(buf + n, c, cl);
+            n += cl;
+        }
+        *len = n;
+        return buf;
+    }
+
+    n += sprintf(buf, "cmd ");
+    if (!strcmp(kind, "long-quoted")) {
+        buf[n++] = '"';
+        while (n < INPUT_SIZE - 2) {
+            buf[n] = (n % 61 == 0) ? ' ' : b64[n % 64];
+            n++;
+        }
+        buf[n++] = '"';
+    } else if (!strcmp(kind, "many-pipes")) {
+        while (n < INPUT_SIZE - 16) {
+            n += sprintf(buf + n, "arg%zu | cmd ", n % 1000);
+        }
+        n += sprintf(buf + n, "end");
+    } else if (!strcmp(kind, "plain-arg")) {
+        while (n < INPUT_SIZE - 1) {
+            buf[n] = b64[n % 64];
+            n++;
+        }
+    } else {
+        while (n < INPUT_SIZE - 1) {
+            buf[n] = (n % 8 == 0) ? ' ' : b64[n % 64];
+            n++;
+        }
+    }
+    buf[n++] = '\n';
+    *len = n;
+    return buf;
+}
@@ -0,0 +1,40 @@
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include "pipeline.h"
+
+typedef struct {
+    double start; // monotonic seconds when it was launched
+    double wall; // seconds from launch until it was reaped
+    double user; // cpu seconds
+    double sys;
+    long maxrss; // KB
+    long minflt; // page faults without and with io
+    long majflt;
+    long nvcsw; // context switches, voluntary and not
+    long nivcsw;
+} cmd_usage;
+
+double acct_now ();
+
+void acct_start (cmd_usage *);
+
+void acct_reaped (cmd_usage *, const struct rusage *);
+
+void acct_since (cmd_usage *, const struct rusage *, const struct rusage *);
+
+void acct_add (cmd_usage *, const cmd_usage *);
+
+void acct_record (const cmd_usage *, const char *);
+
+void acct_record_pipeline (const cmd_usage *, const pipeline *);
+
+void acct_print_header (FILE *);
+
+void acct_print (FILE *, const char *, const cmd_usage *, const char *);
+
+void acct_summary (FILE *);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    _Alignas(16) char data[];
+} arena_block;
+
+typedef struct {
+    arena_block *head; // block being allocated from, the largest one
+} arena;
+
+void *arena_alloc (arena *, size_t);
+
+void arena_reset (arena *);
+
+void arena_free (arena *);
+
+#endif
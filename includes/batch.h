@@ -0,0 +1,15 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include "pipeline.h"
+
+bool batch_fits (char *const *);
+
+int batch_keep (const stage *);
+
+int batch_leading_opts (char *const *, int);
+
+int batch_run (const stage *, const char *, int);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <stdbool.h>
+#include "tokenizer.h"
+
+bool echo_cmd (ListHandler);
+
+bool true_cmd (ListHandler);
+
+bool false_cmd (ListHandler);
+
+bool test_cmd (ListHandler);
+
+bool printf_cmd (ListHandler);
+
+bool read_cmd (ListHandler);
+
+bool cat_cmd (ListHandler);
+
+#endif
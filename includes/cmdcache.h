@@ -0,0 +1,33 @@
+#ifndef CMDCACHE_H
+#define CMDCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "tokenizer.h"
+#include "pipeline.h"
+
+typedef struct cmd_entry {
+    unsigned long hash;
+    char *line;
+    size_t len;
+    ListHandler tlist; // tokens of the line, never modified
+    pipeline pl; // tlist split into stages
+    bool builtin; // runs in the shell as an internal command
+    int refs; // users that got it from cmd_cache_get
+    bool dead; // no longer cached, freed when refs drops to 0
+    struct cmd_entry *prev; // recency list, most recent first
+    struct cmd_entry *next;
+    struct cmd_entry *chain; // next entry in the same bucket
+} cmd_entry;
+
+const cmd_entry *cmd_cache_get (const char *, size_t);
+
+void cmd_cache_put (const cmd_entry *);
+
+void cmd_cache_resize (int);
+
+void cmd_cache_clear ();
+
+void cmd_cache_print ();
+
+#endif
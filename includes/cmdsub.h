@@ -0,0 +1,12 @@
+#ifndef CMDSUB_H
+#define CMDSUB_H
+
+#include <stddef.h>
+
+char *cmdsub_capture (const char *, size_t, size_t *);
+
+int cmdsub_mark ();
+
+void cmdsub_release (int);
+
+#endif
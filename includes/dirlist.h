@@ -0,0 +1,29 @@
+#ifndef DIRLIST_H
+#define DIRLIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+typedef struct dir_list {
+    char *names; // every name in sorted order, each ending in \0
+    uint32_t *order; // offset of each name, and one past the last
+    unsigned char *types; // d_type of each name, in order's order
+    int count;
+    dev_t dev; // the directory, as it was when it was read
+    ino_t ino;
+    struct timespec mtime;
+    size_t bytes; // memory it holds
+    int refs; // users that got it from dir_list_get
+    bool cached; // in the cache, else freed when refs drops to 0
+} dir_list;
+
+const dir_list *dir_list_get (const char *);
+
+void dir_list_put (const dir_list *);
+
+bool dir_list_is_dir (const dir_list *, const char *, int, bool);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* hands out the lines after the one being run, for here documents.
+ * Returns a line's length, with its \n if it has one, or -1 at the end */
+typedef ssize_t (*next_line) (void *, char **);
+
+void run_line (const char *, size_t, next_line, void *);
+
+void run_line_in_place (char *, size_t, next_line, void *);
+
+int last_status ();
+
+#endif
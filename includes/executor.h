@@ -1,8 +1,22 @@
 #ifndef EXECUTOR_H
 #define EXECUTOR_H
 
-#include "tokenizer.h"
+#include "pipeline.h"
+#include "jobs.h"
+#include <sys/types.h>
 
-void execute (tok_node *);
+int execute (const pipeline *);
+
+int last_pipe_status (const int **, int *);
+
+int last_pipe_usage (const cmd_usage **, int *);
+
+pid_t launch_stage (const stage *, int, int, int *);
+
+int resume_job (job *, bool);
+
+bool open_redirects (const stage *, int *, int *);
+
+long parse_pipe_size (const char *);
 
 #endif
@@ -0,0 +1,9 @@
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include <stdbool.h>
+#include "tokenizer.h"
+
+bool expand_tokens (ListHandler, ListHandler *);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include "pipeline.h"
+
+int run_fanout (const stage *, int, long);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void history_start (const char *, size_t);
+
+void history_finish (int);
+
+const char *history_recall (const char *, size_t, size_t *);
+
+bool history_print (long);
+
+bool history_search (const char *);
+
+#endif
@@ -2,7 +2,16 @@
 #define INTERNAL_H
 
 #include "tokenizer.h"
+#include "pipeline.h"
 
 int run_internal_cmd (ListHandler);
 
+bool is_internal_cmd (const char *);
+
+bool is_shell_line (ListHandler, const pipeline *);
+
+bool is_pure_line (ListHandler, const pipeline *);
+
+int run_builtin_argv (char **, int);
+
 #endif
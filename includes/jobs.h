@@ -0,0 +1,50 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include <signal.h>
+#include <sys/types.h>
+#include "pipeline.h"
+#include "accounting.h"
+
+typedef struct job {
+    int id;
+    pid_t pgid;
+    pid_t *pids; // -1 once a stage has been reaped
+    int *status; // exit code of each reaped stage
+    cmd_usage *usage; // resources used by each reaped stage
+    int count;
+    int live; // stages not reaped yet
+    bool stopped;
+    char *cmd; // the command line, for printing
+    struct job *next;
+} job;
+
+void jobs_init (bool);
+
+int jobs_fd ();
+
+const sigset_t *jobs_child_mask ();
+
+job *job_add (const pipeline *, pid_t, const pid_t *, const int *,
+    const cmd_usage *, int);
+
+job *job_find (int);
+
+job *jobs_first ();
+
+void job_remove (job *);
+
+bool wait_stages (pid_t *, int *, cmd_usage *, int, bool);
+
+int status_code (int);
+
+void jobs_signalled ();
+
+void jobs_update ();
+
+void jobs_notify ();
+
+void jobs_print ();
+
+#endif
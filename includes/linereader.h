@@ -0,0 +1,30 @@
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef struct {
+    int fd;
+    char *buf;
+    size_t cap;
+    size_t start; // first byte not handed out yet
+    size_t scanned; // bytes from start known to have no \n
+    size_t end; // end of the data read so far
+    bool eof;
+    int wake_fd; // polled along with fd, -1 if none
+    void (*on_wake)(); // called when wake_fd is readable
+} line_reader;
+
+void reader_init (line_reader *, int);
+
+void reader_set_wake (line_reader *, int, void (*)());
+
+ssize_t read_line (line_reader *, char **);
+
+ssize_t reader_next_line (void *, char **);
+
+void reader_free (line_reader *);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef METER_H
+#define METER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "pipeline.h"
+
+typedef struct {
+    unsigned long long bytes;
+    double start; // monotonic seconds the relay started and saw EOF
+    double end;
+    double in_wait; // seconds the pipe from the writer was empty
+    double out_wait; // seconds the pipe to the reader was full
+    long in_stalls;
+    long out_stalls;
+} pipe_meter;
+
+typedef struct {
+    pipe_meter *links; // shared with the relay
+    int count;
+    int done_fd; // reads EOF once the relay is gone
+} meter;
+
+bool meter_start (meter *, int (*)[2], int (*)[2], int, pid_t);
+
+void meter_finish (meter *, const pipeline *, bool);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+#include "pipeline.h"
+#include "arena.h"
+
+int run_parallel (const stage *, char **, int, int, bool, arena *);
+
+#endif
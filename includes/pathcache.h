@@ -0,0 +1,18 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <stdbool.h>
+
+const char *path_lookup (const char *);
+
+bool path_cache_add (const char *, const char *);
+
+bool path_cache_remember (const char *);
+
+void path_cache_clear ();
+
+void path_cache_invalidate ();
+
+void path_cache_print ();
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include "tokenizer.h"
+
+enum Read_Write {
+    READ,
+    WRITE,
+    HERE_DOC, // <<, file is the delimiter until the body replaces it
+    HERE_STRING // <<<, file is the text, given with a \n after it
+};
+
+typedef struct {
+    enum Read_Write rw;
+    bool append;
+    char *file;
+} redirect;
+
+typedef struct {
+    char **argv; // NULL terminated, ready for exec
+    int argc;
+    redirect *redirs; // in the order they were given
+    int redir_ct;
+    bool batch; // run as several execs if argv is too big for one
+    int batch_keep; // args after the cmd that every batch starts with
+    int batch_jobs; // batches run at once, 0 is 1
+} stage;
+
+typedef struct {
+    stage *stages;
+    int count;
+    bool background; // ended in &, don't wait for it
+    long pipe_size; // bytes per pipe, 0 for the session's default
+    bool meter; // relay and measure every pipe
+    int here_docs; // << redirects, whose bodies follow the line
+    int substs; // <(cmd) and >(cmd) tokens, args or redirect files
+    int expands; // tokens with $(cmd) or `cmd` in them
+} pipeline;
+
+void build_pipeline (ListHandler, pipeline *);
+
+char *pipeline_text (const pipeline *);
+
+bool is_proc_subst (const tok_node *);
+
+#endif
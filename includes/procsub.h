@@ -0,0 +1,20 @@
+#ifndef PROCSUB_H
+#define PROCSUB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+int procsub_open (const char *, size_t, bool);
+
+pid_t subshell (const char *, size_t, int, int, bool);
+
+int procsub_mark ();
+
+void procsub_inherit (char **, bool);
+
+void procsub_close (int, bool);
+
+void procsub_reap ();
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+typedef enum {
+    SCAN_AUTO, // best the cpu supports
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+} scan_mode;
+
+size_t scan_plain (const char *, size_t);
+
+scan_mode scan_set_mode (scan_mode);
+
+const char *scan_mode_name (scan_mode);
+
+#endif
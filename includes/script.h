@@ -0,0 +1,6 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+int run_script (int);
+
+#endif
@@ -2,23 +2,40 @@
 #define TOKENIZER_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
 
-typedef struct tok_node {
+/* substitutions and patterns are left in a token's text with marks, to
+ * be done each time the line runs. Input with a mark in it is rejected,
+ * and text substituted into a pattern has any MARK_GLOB in it doubled,
+ * which is a literal MARK_GLOB char */
+#define MARK_CMD '\x01' // MARK_CMD q|u cmd MARK_CMD, for $(cmd) and `cmd`
+#define MARK_VAR '\x02' // MARK_VAR q|u NAME MARK_VAR, for $NAME and ${NAME}
+#define MARK_GLOB '\x03' // before each unquoted *, ? or [ of a pattern
+#define MARKS "\x01\x02\x03"
+
+typedef struct {
     char *token;
     bool special;
-    struct tok_node *next;
 } tok_node;
 
 typedef struct {
-    void *head;
-    void *tail;
+    tok_node *head; // array of count tokens
     int count;
-}ListHandler;
+    int cap;
+    arena *mem; // holds the tokens and their strings
+} ListHandler;
+
+void init_tok_list (ListHandler *);
 
-void tokenize (ListHandler *, char *);
+void tokenize (ListHandler *, char *, size_t);
+
+void tokenize_in_place (ListHandler *, char *, size_t);
 
 void free_tok_list (ListHandler *);
 
-void print_tokens (tok_node *);
+void destroy_tok_list (ListHandler *);
+
+void print_tokens (ListHandler);
 
 #endif
@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    PH_READ, // waiting for and reading a line
+    PH_TOKENIZE, // tokenize and build_pipeline
+    PH_BUILTIN, // running an internal command
+    PH_LOOKUP, // finding the cmd in $PATH
+    PH_SPAWN, // posix_spawn (which returns after exec) or fork
+    PH_WAIT, // reaping the pipeline
+    PHASE_CT
+} trace_phase;
+
+typedef enum {
+    CNT_LINES,
+    CNT_ALLOCS, // arena_alloc calls
+    CNT_BLOCKS, // arena blocks malloced
+    CNT_SPAWNS,
+    CNT_FORKS,
+    CNT_DIR_SCANS, // PATH directories read
+    CNT_PATH_HITS,
+    CNT_PATH_MISSES,
+    CNT_CMD_HITS, // command cache
+    CNT_CMD_MISSES,
+    COUNTER_CT
+} trace_counter;
+
+extern bool trace_on;
+extern unsigned long trace_counters[COUNTER_CT];
+
+void trace_init ();
+
+void trace_enable (bool);
+
+uint64_t trace_ns ();
+
+void trace_add (trace_phase, uint64_t);
+
+void trace_line_begin ();
+
+void trace_line_end (const char *, size_t);
+
+void trace_print ();
+
+void trace_reset ();
+
+/* phases are only timed while tracing is on, counters always count */
+static inline uint64_t trace_start ()
+{
+    return trace_on ? trace_ns() : 0;
+}
+
+static inline void trace_stop (trace_phase phase, uint64_t start)
+{
+    if (trace_on && start != 0) {
+        trace_add(phase, start);
+    }
+}
+
+static inline void trace_count (trace_counter c)
+{
+    trace_counters[c]++;
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef VARS_H
+#define VARS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+const char *var_get (const char *);
+
+const char *var_getn (const char *, size_t);
+
+bool var_set (const char *, const char *, bool);
+
+bool var_setn (const char *, size_t, const char *, bool);
+
+void var_unset (const char *);
+
+bool var_export (const char *);
+
+char **var_envp ();
+
+bool var_name_ok (const char *, size_t);
+
+size_t var_assign_len (const char *);
+
+void var_print (bool);
+
+#endif
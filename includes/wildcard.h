@@ -0,0 +1,8 @@
+#ifndef WILDCARD_H
+#define WILDCARD_H
+
+#include "arena.h"
+
+int wildcard_expand (const char *, arena *, char ***);
+
+#endif
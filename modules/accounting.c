@@ -0,0 +1,221 @@
+/************************************************
+ *                accounting.c                  *
+ ************************************************
+ * accounting keeps the resources used by each  *
+ * command (from wait4's rusage and a monotonic *
+ * clock) and totals for the whole session      *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/accounting.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SLOWEST_KEPT 5
+
+typedef struct {
+    double wall;
+    char *cmd;
+} slow_cmd;
+
+static double tv_secs (struct timeval);
+static void keep_if_slow (double, const char *);
+
+static long cmd_ct = 0;
+static cmd_usage session; // every command added up
+static slow_cmd slowest[SLOWEST_KEPT]; // slowest first
+static int slow_ct = 0;
+static double session_start = -1;
+
+/**
+ * seconds on the monotonic clock
+ */
+double acct_now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * clears u and stamps it with the current time, right before a
+ * command is launched
+ */
+void acct_start (cmd_usage *u)
+{
+    memset(u, 0, sizeof(cmd_usage));
+    u->start = acct_now();
+    if (session_start < 0) {
+        session_start = u->start;
+    }
+}
+
+/**
+ * fills u in from the rusage wait4 gave for it
+ */
+void acct_reaped (cmd_usage *u, const struct rusage *ru)
+{
+    u->wall = acct_now() - u->start;
+    u->user = tv_secs(ru->ru_utime);
+    u->sys = tv_secs(ru->ru_stime);
+    u->maxrss = ru->ru_maxrss;
+    u->minflt = ru->ru_minflt;
+    u->majflt = ru->ru_majflt;
+    u->nvcsw = ru->ru_nvcsw;
+    u->nivcsw = ru->ru_nivcsw;
+}
+
+/**
+ * fills u in with what was used between two getrusage calls, for
+ * things that run in the shell itself. maxrss can only be the peak
+ */
+void acct_since (cmd_usage *u, const struct rusage *before,
+    const struct rusage *after)
+{
+    u->wall = acct_now() - u->start;
+    u->user = tv_secs(after->ru_utime) - tv_secs(before->ru_utime);
+    u->sys = tv_secs(after->ru_stime) - tv_secs(before->ru_stime);
+    u->maxrss = after->ru_maxrss;
+    u->minflt = after->ru_minflt - before->ru_minflt;
+    u->majflt = after->ru_majflt - before->ru_majflt;
+    u->nvcsw = after->ru_nvcsw - before->ru_nvcsw;
+    u->nivcsw = after->ru_nivcsw - before->ru_nivcsw;
+}
+
+/**
+ * adds u to total. Stages of a pipeline run side by side, so the wall
+ * time and rss are the largest of them rather than the sum
+ */
+void acct_add (cmd_usage *total, const cmd_usage *u)
+{
+    if (total->start == 0 || (u->start != 0 && u->start < total->start)) {
+        total->start = u->start;
+    }
+    if (u->wall > total->wall) {
+        total->wall = u->wall;
+    }
+    if (u->maxrss > total->maxrss) {
+        total->maxrss = u->maxrss;
+    }
+    total->user += u->user;
+    total->sys += u->sys;
+    total->minflt += u->minflt;
+    total->majflt += u->majflt;
+    total->nvcsw += u->nvcsw;
+    total->nivcsw += u->nivcsw;
+}
+
+/**
+ * counts one finished command in the session totals. cmd is copied if
+ * it is one of the slowest so far
+ */
+void acct_record (const cmd_usage *u, const char *cmd)
+{
+    cmd_ct++;
+    session.wall += u->wall;
+    session.user += u->user;
+    session.sys += u->sys;
+    if (u->maxrss > session.maxrss) {
+        session.maxrss = u->maxrss;
+    }
+    session.minflt += u->minflt;
+    session.majflt += u->majflt;
+    session.nvcsw += u->nvcsw;
+    session.nivcsw += u->nivcsw;
+    keep_if_slow(u->wall, cmd);
+}
+
+/**
+ * acct_record for a pipeline, only writing out its text if it is one
+ * of the slowest
+ */
+void acct_record_pipeline (const cmd_usage *u, const pipeline *pl)
+{
+    bool slow = slow_ct < SLOWEST_KEPT || u->wall > slowest[slow_ct-1].wall;
+    char *text = slow ? pipeline_text(pl) : NULL;
+    acct_record(u, text);
+    free(text);
+}
+
+/**
+ * column names for acct_print
+ */
+void acct_print_header (FILE *out)
+{
+    fprintf(out, "%-6s %9s %9s %9s %9s %8s %6s %7s %7s  %s\n", "", "real",
+        "user", "sys", "maxrss", "minflt", "majflt", "vcsw", "ivcsw",
+        "command");
+}
+
+/**
+ * prints one line of usage, labelled with name and followed by cmd
+ */
+void acct_print (FILE *out, const char *name, const cmd_usage *u,
+    const char *cmd)
+{
+    fprintf(out, "%-6s %8.3fs %8.3fs %8.3fs %7ldKB %8ld %6ld %7ld %7ld  %s\n",
+        name, u->wall, u->user, u->sys, u->maxrss, u->minflt, u->majflt,
+        u->nvcsw, u->nivcsw, cmd ? cmd : "");
+}
+
+/**
+ * prints the session totals and the slowest commands
+ */
+void acct_summary (FILE *out)
+{
+    double elapsed = session_start < 0 ? 0 : acct_now() - session_start;
+    fprintf(out, "commands run:  %ld in %.3fs\n", cmd_ct, elapsed);
+    fprintf(out, "total cpu:     %.3fs user, %.3fs sys\n", session.user,
+        session.sys);
+    fprintf(out, "peak rss:      %ldKB\n", session.maxrss);
+    fprintf(out, "page faults:   %ld minor, %ld major\n", session.minflt,
+        session.majflt);
+    fprintf(out, "ctx switches:  %ld voluntary, %ld involuntary\n",
+        session.nvcsw, session.nivcsw);
+    if (slow_ct > 0) {
+        fprintf(out, "slowest:\n");
+    }
+    for (int i = 0; i < slow_ct; i++) {
+        fprintf(out, "  %9.3fs  %s\n", slowest[i].wall, slowest[i].cmd);
+    }
+}
+
+/**
+ * converts a timeval to seconds
+ */
+static double tv_secs (struct timeval tv)
+{
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * puts cmd in the slowest list if it took longer than the last one,
+ * keeping the list sorted
+ */
+static void keep_if_slow (double wall, const char *cmd)
+{
+    if (cmd == NULL) {
+        return;
+    }
+    if (slow_ct == SLOWEST_KEPT) {
+        if (wall <= slowest[slow_ct-1].wall) {
+            return;
+        }
+        free(slowest[--slow_ct].cmd);
+    }
+    char *copy = strdup(cmd);
+    if (copy == NULL) {
+        perror("malloc failed in acct_record");
+        exit(-1);
+    }
+    int i = slow_ct++;
+    while (i > 0 && slowest[i-1].wall < wall) {
+        slowest[i] = slowest[i-1];
+        i--;
+    }
+    slowest[i].wall = wall;
+    slowest[i].cmd = copy;
+}
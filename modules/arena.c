@@ -0,0 +1,90 @@
+/************************************************
+ *                   arena.c                    *
+ ************************************************
+ * arena is a bump allocator for memory that    *
+ * only lives as long as one line of input. It  *
+ * is reset instead of freed piece by piece     *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/arena.h"
+#include "../includes/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MIN_BLOCK_SIZE 4096
+#define ALIGNMENT 16
+
+static arena_block* new_block (size_t);
+
+/**
+ * gets size bytes from the arena, aligned for any type. Never
+ * returns NULL, exits if memory runs out
+ */
+void *arena_alloc (arena *a, size_t size)
+{
+    trace_count(CNT_ALLOCS);
+    size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    arena_block *block = a->head;
+    if (block == NULL || block->size - block->used < size) {
+        /* grow geometrically so a line needs few blocks */
+        size_t want = block ? block->size * 2 : MIN_BLOCK_SIZE;
+        while (want < size) {
+            want *= 2;
+        }
+        block = new_block(want);
+        block->next = a->head;
+        a->head = block;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+/**
+ * makes all memory in the arena free again. Only the largest block
+ * is kept so the next line usually fits in one block
+ */
+void arena_reset (arena *a)
+{
+    if (a->head == NULL) {
+        return;
+    }
+    arena_block *block = a->head->next;
+    while (block != NULL) {
+        arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    a->head->next = NULL;
+    a->head->used = 0;
+}
+
+/**
+ * gives every block back to the system
+ */
+void arena_free (arena *a)
+{
+    arena_reset(a);
+    free(a->head);
+    a->head = NULL;
+}
+
+/**
+ * mallocs a block with size usable bytes
+ */
+static arena_block* new_block (size_t size)
+{
+    trace_count(CNT_BLOCKS);
+    arena_block *block = malloc(sizeof(arena_block) + size);
+    if (block == NULL) {
+        perror("malloc failed in arena_alloc");
+        exit(-1);
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
@@ -0,0 +1,215 @@
+/************************************************
+ *                   batch.c                    *
+ ************************************************
+ * batch measures what an exec's argv and envp  *
+ * take against ARG_MAX, and runs a command     *
+ * whose args don't fit as few execs as it      *
+ * can, each with as many args as fit, the way  *
+ * xargs would                                  *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/batch.h"
+#include "../includes/vars.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+/* execve also copies the file name and needs room to spare for what
+ * the loader puts on the stack, so this much of ARG_MAX isn't used */
+#define ARG_HEADROOM 4096
+/* the kernel's limit on any one arg or environment string */
+#define MAX_ARG_STRLEN (32 * 4096)
+
+static size_t arg_limit ();
+static size_t vec_bytes (char *const *, int);
+static bool reap (int *);
+
+/**
+ * true if argv and the environment fit in one exec, which also needs
+ * every arg to be under the kernel's limit on one string
+ */
+bool batch_fits (char *const *argv)
+{
+    for (int i = 0; argv[i] != NULL; i++) {
+        if (strlen(argv[i]) + 1 > MAX_ARG_STRLEN) {
+            return false;
+        }
+    }
+    size_t bytes = vec_bytes(argv, -1) + vec_bytes(var_envp(), -1);
+    return bytes <= arg_limit();
+}
+
+/**
+ * how many args after the cmd a stage whose argv doesn't fit keeps in
+ * every batch, or -1 if it can't be split. Stages run with the batch
+ * builtin say themselves. Otherwise $MYCLI_BATCH lists the cmds that
+ * may be split, as "name" to keep the options it starts with or
+ * "name:n" to keep n args, separated by spaces
+ */
+int batch_keep (const stage *st)
+{
+    if (st->batch) {
+        return st->batch_keep;
+    }
+    const char *list = var_get("MYCLI_BATCH");
+    if (list == NULL) {
+        return -1;
+    }
+    const char *cmd = strrchr(st->argv[0], '/');
+    cmd = cmd ? cmd + 1 : st->argv[0];
+    size_t len = strlen(cmd);
+    while (*list) {
+        size_t n = strcspn(list, " :");
+        if (n == len && !strncmp(list, cmd, len)) {
+            if (list[n] == ':') {
+                return atoi(list + n + 1);
+            }
+            return batch_leading_opts(st->argv, st->argc);
+        }
+        list += n;
+        if (*list == ':') {
+            list += strcspn(list, " ");
+        }
+        list += strspn(list, " ");
+    }
+    return -1;
+}
+
+/**
+ * how many args after argv[0] are options, which every batch has to
+ * start with: those starting with -, up to a -- which is one of them
+ */
+int batch_leading_opts (char *const *argv, int argc)
+{
+    int n = 0;
+    while (n + 1 < argc && argv[n + 1][0] == '-') {
+        n++;
+        if (!strcmp(argv[n], "--")) {
+            break;
+        }
+    }
+    return n;
+}
+
+/**
+ * runs bin with the args of st split into batches that each fit in one
+ * exec. Every batch starts with the cmd and the keep args after it,
+ * and gets as many of the rest as fit, in order, so there are as few
+ * execs as there can be. Up to st->batch_jobs run at once. Only a
+ * forked copy of the shell calls this. Returns the highest exit status
+ */
+int batch_run (const stage *st, const char *bin, int keep)
+{
+    if (keep + 1 > st->argc) {
+        keep = st->argc - 1;
+    }
+    char **envp = var_envp();
+    size_t limit = arg_limit();
+    size_t fixed = vec_bytes(st->argv, keep + 1) + vec_bytes(envp, -1);
+    if (fixed >= limit) {
+        fprintf(stderr, "%s: argument list too long\n", st->argv[0]);
+        return 126;
+    }
+    int jobs = st->batch_jobs > 0 ? st->batch_jobs : 1;
+
+    /* the args are in the caller's arena, each batch only needs pointers */
+    char **argv = malloc(sizeof(char *) * (st->argc + 1));
+    if (argv == NULL) {
+        perror("malloc failed in batch_run");
+        return 126;
+    }
+    memcpy(argv, st->argv, sizeof(char *) * (keep + 1));
+
+    int running = 0, worst = 0;
+    int i = keep + 1;
+    while (i < st->argc) {
+        int n = keep + 1;
+        size_t used = fixed;
+        while (i < st->argc) {
+            size_t len = strlen(st->argv[i]) + 1;
+            if (len > MAX_ARG_STRLEN || used + len + sizeof(char *) > limit) {
+                break;
+            }
+            used += len + sizeof(char *);
+            argv[n++] = st->argv[i++];
+        }
+        if (n == keep + 1) { // this arg doesn't fit even on its own
+            fprintf(stderr, "%s: argument too long: %.40s...\n",
+                st->argv[0], st->argv[i]);
+            worst = 126;
+            i++;
+            continue;
+        }
+        argv[n] = NULL;
+
+        if (running == jobs && reap(&worst)) {
+            running--;
+        }
+        pid_t pid;
+        int err = posix_spawn(&pid, bin, NULL, NULL, argv, envp);
+        if (err != 0) {
+            fprintf(stderr, "could not exec %s: %s\n", st->argv[0],
+                strerror(err));
+            worst = 126;
+            break;
+        }
+        running++;
+    }
+    while (running > 0 && reap(&worst)) {
+        running--;
+    }
+    free(argv);
+    return worst;
+}
+
+/**
+ * the bytes an exec may take for argv and envp
+ */
+static size_t arg_limit ()
+{
+    static size_t limit = 0;
+    if (limit == 0) {
+        long max = sysconf(_SC_ARG_MAX);
+        limit = (max > 2 * ARG_HEADROOM ? max : 2 * ARG_HEADROOM) -
+            ARG_HEADROOM;
+    }
+    return limit;
+}
+
+/**
+ * the bytes the first n strings of v (all of them if n < 0) take on a
+ * new process's stack: each string with its \0, a pointer to each and
+ * the NULL after them
+ */
+static size_t vec_bytes (char *const *v, int n)
+{
+    size_t bytes = sizeof(char *);
+    for (int i = 0; n < 0 ? v[i] != NULL : i < n; i++) {
+        bytes += strlen(v[i]) + 1 + sizeof(char *);
+    }
+    return bytes;
+}
+
+/**
+ * waits for one batch to finish, raising worst to its exit status.
+ * Returns false if there was nothing to wait for
+ */
+static bool reap (int *worst)
+{
+    int status;
+    if (wait(&status) < 0) {
+        return false;
+    }
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) :
+        128 + WTERMSIG(status);
+    if (code > *worst) {
+        *worst = code;
+    }
+    return true;
+}
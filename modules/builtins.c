@@ -0,0 +1,1053 @@
+/************************************************
+ *                 builtins.c                   *
+ ************************************************
+ * builtins are shell versions of the small     *
+ * utilities scripts use the most, so running   *
+ * them doesn't cost a fork and an exec         *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#define _GNU_SOURCE
+
+#include "../includes/builtins.h"
+#include "../includes/executor.h"
+#include "../includes/pathcache.h"
+#include "../includes/jobs.h"
+#include "../includes/vars.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#define READ_CHUNK 256
+#define COPY_CHUNK (16 * 1024 * 1024) // per kernel copy call, between ^C checks
+#define COPY_BUF (128 * 1024) // for the read/write fallback
+#define SPEC_SIZE 64 // a printf conversion spec, with its ll and \0
+
+enum Copy_Method {
+    COPY_FILE_RANGE,
+    SPLICE,
+    SENDFILE
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+typedef struct {
+    char **argv;
+    int argc;
+    int pos; // next arg to look at
+    bool err; // bad expression, already reported
+} test_args;
+
+static const char *put_escape (FILE *, const char *, bool, bool *);
+static const char *put_conversion (const char *, char **, int, int *,
+    bool *, bool *);
+static char **tok_argv (ListHandler, int);
+static bool spec_append (char *, int *, const char *, int);
+static long long to_number (const char *, bool *);
+static bool test_expr (test_args *, int);
+static bool test_or (test_args *);
+static bool test_and (test_args *);
+static bool test_not (test_args *);
+static bool test_primary (test_args *);
+static bool is_unary (const char *);
+static bool is_binary (const char *);
+static bool unary (test_args *, const char *, const char *);
+static bool binary (test_args *, const char *, const char *, const char *);
+static long long test_int (test_args *, const char *);
+static ssize_t read_input (char **, char **, bool, bool *);
+static int ifs_char (const char *, const char *, const char *, ssize_t);
+static bool copy_fd (int, int, const char *);
+static int kernel_copy (enum Copy_Method, int, int);
+static bool real_cat (ListHandler);
+static void on_interrupt (int);
+
+/**
+ * echo [-neE] [arg...]
+ * prints the args separated by spaces. -n leaves off the newline, -e
+ * turns on backslash escapes and -E turns them back off
+ */
+bool echo_cmd (ListHandler tlist)
+{
+    bool newline = true;
+    bool escapes = false;
+    int i = 1;
+    for (; i < tlist.count; i++) {
+        char *arg = tlist.head[i].token;
+        if (arg[0] != '-' || arg[1] == '\0' ||
+            arg[strspn(arg + 1, "neE") + 1] != '\0') {
+            break; // not only option letters
+        }
+        for (char *c = arg + 1; *c; c++) {
+            if (*c == 'n') {
+                newline = false;
+            } else {
+                escapes = (*c == 'e');
+            }
+        }
+    }
+
+    bool stop = false;
+    for (int first = i; i < tlist.count && !stop; i++) {
+        if (i > first) {
+            putchar(' ');
+        }
+        const char *s = tlist.head[i].token;
+        if (!escapes) {
+            fputs(s, stdout);
+            continue;
+        }
+        while (*s && !stop) {
+            if (*s == '\\') {
+                s = put_escape(stdout, s + 1, true, &stop);
+            } else {
+                putchar(*s++);
+            }
+        }
+    }
+    if (newline && !stop) {
+        putchar('\n');
+    }
+    return false; // no error
+}
+
+/**
+ * true             does nothing, successfully
+ */
+bool true_cmd (ListHandler tlist)
+{
+    return false;
+}
+
+/**
+ * false            does nothing, unsuccessfully
+ */
+bool false_cmd (ListHandler tlist)
+{
+    return true;
+}
+
+/**
+ * test expr
+ * [ expr ]
+ * fails if expr is false. Takes the file, string and integer tests,
+ * ! ( ) -a and -o of POSIX test. Up to four args are read by how many
+ * there are, like POSIX says, so test ! = ! works
+ */
+bool test_cmd (ListHandler tlist)
+{
+    int argc = tlist.count - 1;
+    if (!strcmp(tlist.head[0].token, "[")) {
+        if (argc == 0 || strcmp(tlist.head[argc].token, "]")) {
+            fprintf(stderr, "[: missing ]\n");
+            return true; // error
+        }
+        argc--;
+    }
+    char **argv = tok_argv(tlist, 1);
+
+    test_args ta = {argv, argc, 0, false};
+    bool result = test_expr(&ta, argc);
+    if (!ta.err && ta.pos < argc) {
+        fprintf(stderr, "test: unexpected %s\n", argv[ta.pos]);
+        ta.err = true;
+    }
+    free(argv);
+    return ta.err || !result;
+}
+
+/**
+ * printf format [arg...]
+ * prints the args as the format says. Takes the conversions of printf(3)
+ * for strings, chars, integers and floats, plus %b for a string with
+ * echo's escapes. The format is used again while there are args left
+ */
+bool printf_cmd (ListHandler tlist)
+{
+    if (tlist.count < 2) {
+        fprintf(stderr, "usage: printf format [arg...]\n");
+        return true; // error
+    }
+    const char *format = tlist.head[1].token;
+    int argc = tlist.count - 2;
+    char **argv = tok_argv(tlist, 2);
+
+    int next = 0;
+    bool err = false;
+    bool stop = false;
+    do {
+        int start = next;
+        const char *s = format;
+        while (*s && !stop) {
+            if (*s == '\\') {
+                s = put_escape(stdout, s + 1, false, &stop);
+            } else if (*s == '%' && s[1] == '%') {
+                putchar('%');
+                s += 2;
+            } else if (*s == '%') {
+                s = put_conversion(s, argv, argc, &next, &err, &stop);
+            } else {
+                putchar(*s++);
+            }
+        }
+        if (next == start) {
+            break; // the format takes no args, don't loop forever
+        }
+    } while (next < argc && !stop);
+    free(argv);
+    return err;
+}
+
+/**
+ * read [-r] [-p prompt] [name...]
+ * reads a line from stdin and splits it at $IFS into the shell
+ * variables named, the last one getting the rest of the line. REPLY
+ * gets the whole line if there are no names. Without -r a backslash
+ * quotes the next character and joins lines. Fails at end of file
+ */
+bool read_cmd (ListHandler tlist)
+{
+    bool raw = false;
+    int i = 1;
+    for (; i < tlist.count; i++) {
+        char *arg = tlist.head[i].token;
+        if (!strcmp(arg, "-r")) {
+            raw = true;
+        } else if (!strcmp(arg, "-p") && i + 1 < tlist.count) {
+            if (isatty(STDIN_FILENO)) {
+                fputs(tlist.head[++i].token, stderr);
+            } else {
+                i++;
+            }
+        } else {
+            break;
+        }
+    }
+    for (int k = i; k < tlist.count; k++) {
+        const char *name = tlist.head[k].token;
+        if (!var_name_ok(name, strlen(name))) {
+            fprintf(stderr, "read: %s: not a valid name\n", name);
+            return true; // error
+        }
+    }
+
+    char *line, *quoted;
+    bool eof;
+    fflush(stdout);
+    ssize_t length = read_input(&line, &quoted, raw, &eof);
+
+    if (i == tlist.count) {
+        var_set("REPLY", line, false);
+        free(line);
+        free(quoted);
+        return eof;
+    }
+
+    const char *ifs = var_get("IFS");
+    if (ifs == NULL) {
+        ifs = " \t\n";
+    }
+    /* IFS whitespace runs count as one separator and are trimmed, other
+     * IFS characters each separate one field */
+    ssize_t pos = 0;
+    while (pos < length && ifs_char(ifs, line, quoted, pos) == 1) {
+        pos++;
+    }
+    for (; i < tlist.count; i++) {
+        ssize_t start = pos, end;
+        if (i == tlist.count - 1) {
+            end = length;
+            while (end > start && ifs_char(ifs, line, quoted, end - 1) == 1) {
+                end--;
+            }
+        } else {
+            while (pos < length && !ifs_char(ifs, line, quoted, pos)) {
+                pos++;
+            }
+            end = pos;
+            while (pos < length && ifs_char(ifs, line, quoted, pos) == 1) {
+                pos++;
+            }
+            if (pos < length && ifs_char(ifs, line, quoted, pos) == 2) {
+                pos++;
+                while (pos < length && ifs_char(ifs, line, quoted, pos) == 1) {
+                    pos++;
+                }
+            }
+        }
+        char saved = line[end];
+        line[end] = '\0';
+        var_set(tlist.head[i].token, line + start, false);
+        line[end] = saved;
+    }
+    free(line);
+    free(quoted);
+    return eof;
+}
+
+/**
+ * cat [-u] [file...]
+ * copies each file, or stdin for - or no files, to stdout. The kernel
+ * moves the data where it can: copy_file_range between files, splice
+ * to or from a pipe and sendfile from a file to anything else. Other
+ * options, and reading a terminal, are left to the real cat
+ */
+bool cat_cmd (ListHandler tlist)
+{
+    int first = 1;
+    if (first < tlist.count && !strcmp(tlist.head[first].token, "-u")) {
+        first++; // output is never buffered anyway
+    }
+    for (int i = first; i < tlist.count; i++) {
+        char *arg = tlist.head[i].token;
+        if (arg[0] == '-' && arg[1] != '\0') {
+            return real_cat(tlist);
+        }
+    }
+    if (isatty(STDIN_FILENO) && (first == tlist.count ||
+        (first + 1 == tlist.count && !strcmp(tlist.head[first].token, "-")))) {
+        return real_cat(tlist); // so ^C and ^D work the usual way
+    }
+
+    /* the shell ignores ^C, catch it instead so long copies can be
+     * stopped */
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_interrupt;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &old);
+    interrupted = 0;
+
+    fflush(stdout);
+    bool err = false;
+    if (first == tlist.count) {
+        err = copy_fd(STDIN_FILENO, STDOUT_FILENO, "-");
+    }
+    for (int i = first; i < tlist.count && !interrupted; i++) {
+        char *name = tlist.head[i].token;
+        if (!strcmp(name, "-")) {
+            err |= copy_fd(STDIN_FILENO, STDOUT_FILENO, name);
+            continue;
+        }
+        int fd = open(name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "cat: ");
+            perror(name);
+            err = true;
+            continue;
+        }
+        err |= copy_fd(fd, STDOUT_FILENO, name);
+        close(fd);
+    }
+
+    sigaction(SIGINT, &old, NULL);
+    return err || interrupted;
+}
+
+/**
+ * prints the backslash escape at s, which is just past the \, to out
+ * and returns where it ends. Octal escapes are \0nnn for echo and %b
+ * (zero_octal) and \nnn in printf formats. \c sets stop
+ */
+static const char *put_escape (FILE *out, const char *s, bool zero_octal,
+    bool *stop)
+{
+    static const char from[] = "abefnrtv\\";
+    static const char to[] = "\a\b\033\f\n\r\t\v\\";
+    const char *found = (*s != '\0') ? strchr(from, *s) : NULL;
+    if (found != NULL) {
+        fputc(to[found - from], out);
+        return s + 1;
+    }
+    if (*s == 'c') {
+        *stop = true;
+        return s + 1;
+    }
+
+    int value = 0, digits = 0;
+    if (*s == 'x' && isxdigit((unsigned char)s[1])) {
+        for (s++; digits < 2 && isxdigit((unsigned char)*s); s++, digits++) {
+            value = value * 16 + (isdigit((unsigned char)*s) ? *s - '0' :
+                tolower((unsigned char)*s) - 'a' + 10);
+        }
+        fputc(value, out);
+        return s;
+    }
+    if (*s >= '0' && *s <= '7' && (*s == '0' || !zero_octal)) {
+        if (zero_octal) {
+            s++; // the 0 doesn't count toward the three digits
+        }
+        for (; digits < 3 && *s >= '0' && *s <= '7'; s++, digits++) {
+            value = value * 8 + *s - '0';
+        }
+        fputc(value, out);
+        return s;
+    }
+
+    fputc('\\', out); // not an escape, print it as is
+    return s;
+}
+
+/**
+ * a NULL terminated copy of the tokens of tlist from first on, for the
+ * builtins that want an argv. It is on the heap, as a line can have
+ * more words than the stack has room for. The caller frees it
+ */
+static char **tok_argv (ListHandler tlist, int first)
+{
+    int argc = tlist.count > first ? tlist.count - first : 0;
+    char **argv = malloc(sizeof(char *) * (argc + 1));
+    if (argv == NULL) {
+        perror("malloc failed in tok_argv");
+        exit(-1);
+    }
+    for (int i = 0; i < argc; i++) {
+        argv[i] = tlist.head[first + i].token;
+    }
+    argv[argc] = NULL;
+    return argv;
+}
+
+/**
+ * appends the n chars at s to a printf spec of len chars if they still
+ * leave room for the longest ending, "lld" and its \0. Returns false,
+ * appending nothing, if they don't
+ */
+static bool spec_append (char *spec, int *len, const char *s, int n)
+{
+    if (*len + n > SPEC_SIZE - (int)sizeof("lld")) {
+        return false;
+    }
+    memcpy(spec + *len, s, n);
+    *len += n;
+    return true;
+}
+
+/**
+ * prints the printf conversion that starts at the % at s using the next
+ * arg, or an empty one if they ran out. Returns where the conversion
+ * ends. Bad numbers set err, \c inside %b sets stop
+ */
+static const char *put_conversion (const char *s, char **argv, int argc,
+    int *next, bool *err, bool *stop)
+{
+    /* copy the flags, width and precision into a spec for printf(3),
+     * with any * replaced by its arg. One too long to fit is a bad
+     * conversion */
+    char spec[SPEC_SIZE];
+    int len = 0;
+    bool fits = true;
+    spec[len++] = *s++;
+    while (*s && strchr("-+ #0", *s)) {
+        fits &= spec_append(spec, &len, s++, 1);
+    }
+    for (int part = 0; part < 2; part++) {
+        if (part == 1) {
+            if (*s != '.') {
+                break;
+            }
+            fits &= spec_append(spec, &len, s++, 1);
+        }
+        if (*s == '*') {
+            const char *arg = (*next < argc) ? argv[(*next)++] : "0";
+            char num[12];
+            int n = snprintf(num, sizeof(num), "%d", (int)to_number(arg, err));
+            fits &= spec_append(spec, &len, num, n);
+            s++;
+        } else {
+            while (isdigit((unsigned char)*s)) {
+                fits &= spec_append(spec, &len, s++, 1);
+            }
+        }
+    }
+
+    char conv = *s;
+    if (!fits || conv == '\0' || !strchr("diouxXcsbfFeEgGaA", conv)) {
+        fprintf(stderr, "printf: bad conversion %.*s%c\n", len, spec, conv);
+        *err = true;
+        return conv ? s + 1 : s;
+    }
+    s++;
+    const char *arg = (*next < argc) ? argv[(*next)++] : NULL;
+
+    if (conv == 'd' || conv == 'i') {
+        strcpy(spec + len, "lld");
+        printf(spec, arg ? to_number(arg, err) : 0LL);
+    } else if (strchr("ouxX", conv)) {
+        sprintf(spec + len, "ll%c", conv);
+        printf(spec, arg ? (unsigned long long)to_number(arg, err) : 0ULL);
+    } else if (conv == 'c') {
+        strcpy(spec + len, "c");
+        printf(spec, arg ? arg[0] : '\0');
+    } else if (conv == 's') {
+        strcpy(spec + len, "s");
+        printf(spec, arg ? arg : "");
+    } else if (conv == 'b') {
+        char *text = NULL;
+        size_t size = 0;
+        FILE *out = open_memstream(&text, &size);
+        if (out == NULL) {
+            perror("open_memstream failed in printf");
+            exit(-1);
+        }
+        for (const char *c = arg ? arg : ""; *c && !*stop;) {
+            if (*c == '\\') {
+                c = put_escape(out, c + 1, true, stop);
+            } else {
+                fputc(*c++, out);
+            }
+        }
+        fclose(out);
+        strcpy(spec + len, "s");
+        printf(spec, text);
+        free(text);
+    } else { // floating point
+        char *end = "";
+        double value = arg ? strtod(arg, &end) : 0;
+        if (*end != '\0') {
+            fprintf(stderr, "printf: %s: not a number\n", arg);
+            *err = true;
+        }
+        sprintf(spec + len, "%c", conv);
+        printf(spec, value);
+    }
+    return s;
+}
+
+/**
+ * reads an integer arg for printf. A leading ' or " gives the value of
+ * the character after it. Anything else that isn't a number sets err
+ */
+static long long to_number (const char *arg, bool *err)
+{
+    if (arg[0] == '\'' || arg[0] == '"') {
+        return (unsigned char)arg[1];
+    }
+    char *end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 0);
+    if (end == arg || *end != '\0' || errno) {
+        fprintf(stderr, "printf: %s: not a number\n", arg);
+        *err = true;
+    }
+    return value;
+}
+
+/**
+ * evaluates n args the way POSIX says to for that many, or as a full
+ * expression when there are more than four
+ */
+static bool test_expr (test_args *ta, int n)
+{
+    char **a = ta->argv + ta->pos;
+    switch (n) {
+    case 0:
+        return false;
+    case 1:
+        ta->pos++;
+        return a[0][0] != '\0';
+    case 2:
+        if (!strcmp(a[0], "!")) {
+            ta->pos++;
+            return !test_expr(ta, 1);
+        }
+        if (is_unary(a[0])) {
+            ta->pos += 2;
+            return unary(ta, a[0], a[1]);
+        }
+        break;
+    case 3:
+        if (is_binary(a[1])) {
+            ta->pos += 3;
+            return binary(ta, a[0], a[1], a[2]);
+        }
+        if (!strcmp(a[0], "!")) {
+            ta->pos++;
+            return !test_expr(ta, 2);
+        }
+        if (!strcmp(a[0], "(") && !strcmp(a[2], ")")) {
+            ta->pos++;
+            bool result = test_expr(ta, 1);
+            ta->pos++;
+            return result;
+        }
+        break;
+    case 4:
+        if (!strcmp(a[0], "!")) {
+            ta->pos++;
+            return !test_expr(ta, 3);
+        }
+        if (!strcmp(a[0], "(") && !strcmp(a[3], ")")) {
+            ta->pos++;
+            bool result = test_expr(ta, 2);
+            ta->pos++;
+            return result;
+        }
+        break;
+    }
+    return test_or(ta);
+}
+
+/**
+ * expr -o expr ...
+ */
+static bool test_or (test_args *ta)
+{
+    bool result = test_and(ta);
+    while (!ta->err && ta->pos < ta->argc &&
+           !strcmp(ta->argv[ta->pos], "-o")) {
+        ta->pos++;
+        bool right = test_and(ta);
+        result = result || right;
+    }
+    return result;
+}
+
+/**
+ * expr -a expr ...
+ */
+static bool test_and (test_args *ta)
+{
+    bool result = test_not(ta);
+    while (!ta->err && ta->pos < ta->argc &&
+           !strcmp(ta->argv[ta->pos], "-a")) {
+        ta->pos++;
+        bool right = test_not(ta);
+        result = result && right;
+    }
+    return result;
+}
+
+/**
+ * ! expr
+ */
+static bool test_not (test_args *ta)
+{
+    if (ta->pos < ta->argc && !strcmp(ta->argv[ta->pos], "!")) {
+        ta->pos++;
+        return !test_not(ta);
+    }
+    return test_primary(ta);
+}
+
+/**
+ * ( expr ), a unary or binary test, or a string that is true if it
+ * isn't empty
+ */
+static bool test_primary (test_args *ta)
+{
+    int left = ta->argc - ta->pos;
+    char **a = ta->argv + ta->pos;
+    if (left <= 0) {
+        fprintf(stderr, "test: argument expected\n");
+        ta->err = true;
+        return false;
+    }
+    if (left >= 3 && is_binary(a[1])) {
+        ta->pos += 3;
+        return binary(ta, a[0], a[1], a[2]);
+    }
+    if (left >= 2 && is_unary(a[0])) {
+        ta->pos += 2;
+        return unary(ta, a[0], a[1]);
+    }
+    if (!strcmp(a[0], "(")) {
+        ta->pos++;
+        bool result = test_or(ta);
+        if (ta->pos >= ta->argc || strcmp(ta->argv[ta->pos], ")")) {
+            if (!ta->err) {
+                fprintf(stderr, "test: missing )\n");
+            }
+            ta->err = true;
+            return false;
+        }
+        ta->pos++;
+        return result;
+    }
+    ta->pos++;
+    return a[0][0] != '\0';
+}
+
+/**
+ * true if op is a test that takes one arg
+ */
+static bool is_unary (const char *op)
+{
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0' &&
+        strchr("bcdefghkLnprsStuwxzOG", op[1]);
+}
+
+/**
+ * true if op is a test that compares two args
+ */
+static bool is_binary (const char *op)
+{
+    static const char *ops[] = {
+        "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+        "-nt", "-ot", "-ef", NULL
+    };
+    for (int i = 0; ops[i] != NULL; i++) {
+        if (!strcmp(op, ops[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * runs the unary test op on arg
+ */
+static bool unary (test_args *ta, const char *op, const char *arg)
+{
+    struct stat st;
+    switch (op[1]) {
+    case 'n':
+        return arg[0] != '\0';
+    case 'z':
+        return arg[0] == '\0';
+    case 't':
+        return isatty(test_int(ta, arg));
+    case 'r':
+        return access(arg, R_OK) == 0;
+    case 'w':
+        return access(arg, W_OK) == 0;
+    case 'x':
+        return access(arg, X_OK) == 0;
+    case 'h':
+    case 'L':
+        return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    }
+
+    if (stat(arg, &st) != 0) {
+        return false;
+    }
+    switch (op[1]) {
+    case 'b':
+        return S_ISBLK(st.st_mode);
+    case 'c':
+        return S_ISCHR(st.st_mode);
+    case 'd':
+        return S_ISDIR(st.st_mode);
+    case 'f':
+        return S_ISREG(st.st_mode);
+    case 'p':
+        return S_ISFIFO(st.st_mode);
+    case 'S':
+        return S_ISSOCK(st.st_mode);
+    case 's':
+        return st.st_size > 0;
+    case 'g':
+        return st.st_mode & S_ISGID;
+    case 'u':
+        return st.st_mode & S_ISUID;
+    case 'k':
+        return st.st_mode & S_ISVTX;
+    case 'O':
+        return st.st_uid == geteuid();
+    case 'G':
+        return st.st_gid == getegid();
+    }
+    return true; // -e
+}
+
+/**
+ * runs the binary test op on a and b
+ */
+static bool binary (test_args *ta, const char *a, const char *op,
+    const char *b)
+{
+    if (!strcmp(op, "=") || !strcmp(op, "==")) {
+        return !strcmp(a, b);
+    } else if (!strcmp(op, "!=")) {
+        return strcmp(a, b) != 0;
+    } else if (!strcmp(op, "<")) {
+        return strcmp(a, b) < 0;
+    } else if (!strcmp(op, ">")) {
+        return strcmp(a, b) > 0;
+    }
+
+    if (op[1] == 'n' || op[1] == 'o' || !strcmp(op, "-ef")) {
+        struct stat sa, sb;
+        bool has_a = stat(a, &sa) == 0;
+        bool has_b = stat(b, &sb) == 0;
+        if (!strcmp(op, "-ef")) {
+            return has_a && has_b && sa.st_dev == sb.st_dev &&
+                sa.st_ino == sb.st_ino;
+        }
+        if (!has_a || !has_b) { // a missing file is older than any other
+            return (op[1] == 'n') ? has_a : has_b;
+        }
+        long diff = sa.st_mtim.tv_sec != sb.st_mtim.tv_sec ?
+            sa.st_mtim.tv_sec - sb.st_mtim.tv_sec :
+            sa.st_mtim.tv_nsec - sb.st_mtim.tv_nsec;
+        return (op[1] == 'n') ? diff > 0 : diff < 0;
+    }
+
+    long long x = test_int(ta, a);
+    long long y = test_int(ta, b);
+    if (!strcmp(op, "-eq")) {
+        return x == y;
+    } else if (!strcmp(op, "-ne")) {
+        return x != y;
+    } else if (!strcmp(op, "-lt")) {
+        return x < y;
+    } else if (!strcmp(op, "-le")) {
+        return x <= y;
+    } else if (!strcmp(op, "-gt")) {
+        return x > y;
+    }
+    return x >= y; // -ge
+}
+
+/**
+ * reads an integer for test, reporting it if it isn't one
+ */
+static long long test_int (test_args *ta, const char *arg)
+{
+    char *end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 10);
+    while (isspace((unsigned char)*end)) {
+        end++;
+    }
+    if (end == arg || *end != '\0' || errno) {
+        fprintf(stderr, "test: %s: integer expected\n", arg);
+        ta->err = true;
+    }
+    return value;
+}
+
+/**
+ * reads one line from stdin without the \n into a malloced line, and
+ * marks which of its characters were quoted by a backslash in the
+ * malloced quoted. Seekable input is read a chunk at a time and seeked
+ * back to just past the line, anything else a byte at a time so no more
+ * than the line is used up. Returns the length, with eof set if the
+ * input ended first
+ */
+static ssize_t read_input (char **line, char **quoted, bool raw, bool *eof)
+{
+    size_t cap = READ_CHUNK, len = 0;
+    *line = malloc(cap);
+    *quoted = malloc(cap);
+    if (*line == NULL || *quoted == NULL) {
+        perror("malloc failed in read_input");
+        exit(-1);
+    }
+    bool seekable = lseek(STDIN_FILENO, 0, SEEK_CUR) >= 0;
+    char buf[READ_CHUNK];
+    ssize_t got = 0, used = 0;
+    bool escaped = false;
+    *eof = false;
+
+    while (true) {
+        if (used == got) {
+            got = read(STDIN_FILENO, buf, seekable ? sizeof(buf) : 1);
+            used = 0;
+            if (got < 0 && errno == EINTR) {
+                got = 0;
+                continue;
+            }
+            if (got <= 0) {
+                *eof = true;
+                break;
+            }
+        }
+        char c = buf[used++];
+        if (c == '\n' && !escaped) {
+            break;
+        }
+        if (!raw && !escaped && c == '\\') {
+            escaped = true;
+            continue;
+        }
+        if (c == '\n') { // a \ at the end joins the next line on
+            escaped = false;
+            continue;
+        }
+        if (len + 1 >= cap) {
+            cap *= 2;
+            char *tmp = realloc(*line, cap);
+            char *qtmp = realloc(*quoted, cap);
+            if (tmp == NULL || qtmp == NULL) {
+                perror("realloc failed in read_input");
+                exit(-1);
+            }
+            *line = tmp;
+            *quoted = qtmp;
+        }
+        (*line)[len] = c;
+        (*quoted)[len++] = escaped;
+        escaped = false;
+    }
+
+    if (seekable && used < got) {
+        lseek(STDIN_FILENO, used - got, SEEK_CUR); // give back the rest
+    }
+    (*line)[len] = '\0';
+    (*quoted)[len] = 0;
+    return len;
+}
+
+/**
+ * 1 if line[k] is IFS whitespace, 2 if it is another IFS character and
+ * 0 if it doesn't separate fields, which quoted ones never do
+ */
+static int ifs_char (const char *ifs, const char *line, const char *quoted,
+    ssize_t k)
+{
+    if (quoted[k] || line[k] == '\0' || strchr(ifs, line[k]) == NULL) {
+        return 0;
+    }
+    return isspace((unsigned char)line[k]) ? 1 : 2;
+}
+
+/**
+ * copies everything from in to out, trying each kernel copy that fits
+ * the kinds of fds they are before falling back to read and write.
+ * Returns true if it failed
+ */
+static bool copy_fd (int in, int out, const char *name)
+{
+    struct stat ist, ost;
+    if (fstat(in, &ist) < 0 || fstat(out, &ost) < 0) {
+        perror("cat: fstat");
+        return true;
+    }
+    if (S_ISDIR(ist.st_mode)) {
+        fprintf(stderr, "cat: %s: Is a directory\n", name);
+        return true;
+    }
+    if (S_ISREG(ist.st_mode) && ist.st_dev == ost.st_dev &&
+        ist.st_ino == ost.st_ino) { // would copy what it writes forever
+        fprintf(stderr, "cat: %s: input file is output file\n", name);
+        return true;
+    }
+
+    int done = 0; // 1 copied, 0 not supported here, -1 failed
+    if (S_ISREG(ist.st_mode) && S_ISREG(ost.st_mode)) {
+        done = kernel_copy(COPY_FILE_RANGE, in, out);
+    }
+    if (done == 0 && (S_ISFIFO(ist.st_mode) || S_ISFIFO(ost.st_mode))) {
+        done = kernel_copy(SPLICE, in, out);
+    }
+    if (done == 0 && S_ISREG(ist.st_mode)) {
+        done = kernel_copy(SENDFILE, in, out);
+    }
+    if (done != 0) {
+        if (done < 0) {
+            fprintf(stderr, "cat: %s: %s\n", name, strerror(errno));
+        }
+        return done < 0;
+    }
+
+    char *buf = malloc(COPY_BUF);
+    if (buf == NULL) {
+        perror("malloc failed in copy_fd");
+        exit(-1);
+    }
+    ssize_t got = 0;
+    while (!interrupted && (got = read(in, buf, COPY_BUF)) != 0) {
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (ssize_t off = 0; off < got;) {
+            ssize_t put = write(out, buf + off, got - off);
+            if (put < 0 && errno != EINTR) {
+                got = -1;
+                break;
+            }
+            off += (put > 0) ? put : 0;
+        }
+        if (got < 0) {
+            break;
+        }
+    }
+    free(buf);
+    if (got < 0) {
+        fprintf(stderr, "cat: %s: %s\n", name, strerror(errno));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * copies in to out with one of the kernel's copy calls until the input
+ * ends. Returns 1 when done, -1 if it failed partway and 0 if the call
+ * refused these fds before anything was copied, so another can be tried.
+ * copy_file_range refuses O_APPEND output with EBADF
+ */
+static int kernel_copy (enum Copy_Method method, int in, int out)
+{
+    bool copied = false;
+    while (!interrupted) {
+        ssize_t n;
+        if (method == COPY_FILE_RANGE) {
+            n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0);
+        } else if (method == SPLICE) {
+            n = splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MOVE);
+        } else {
+            n = sendfile(out, in, NULL, COPY_CHUNK);
+        }
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!copied && (errno == EINVAL || errno == EXDEV ||
+                errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF)) {
+                return 0;
+            }
+            return -1;
+        }
+        copied = true;
+    }
+    return 1;
+}
+
+/**
+ * runs the cat found in $PATH on the same args and waits for it, for
+ * what the builtin doesn't do itself
+ */
+static bool real_cat (ListHandler tlist)
+{
+    const char *bin = path_lookup("cat");
+    if (bin == NULL) {
+        fprintf(stderr, "cat: %s not supported\n", tlist.head[1].token);
+        return true;
+    }
+    char **argv = tok_argv(tlist, 0);
+    argv[0] = (char *)bin; // a path, so it isn't taken for the builtin
+    stage st = {argv, tlist.count, NULL, 0};
+
+    int status;
+    cmd_usage usage;
+    acct_start(&usage);
+    pid_t pid = launch_stage(&st, -1, -1, &status);
+    if (pid >= 0) {
+        wait_stages(&pid, &status, &usage, 1, false);
+    }
+    free(argv);
+    return status != 0;
+}
+
+/**
+ * SIGINT handler while cat runs in the shell
+ */
+static void on_interrupt (int sig)
+{
+    interrupted = 1;
+}
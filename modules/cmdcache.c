@@ -0,0 +1,293 @@
+/************************************************
+ *                 cmdcache.c                   *
+ ************************************************
+ * cmdcache remembers the most recently used    *
+ * input lines already tokenized and split into *
+ * pipeline stages, so a repeated line skips    *
+ * the tokenizer entirely                       *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/cmdcache.h"
+#include "../includes/trace.h"
+#include "../includes/internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CAPACITY 256
+
+static cmd_entry **buckets = NULL;
+static size_t bucket_ct = 0;
+static cmd_entry *mru = NULL; // most recently used
+static cmd_entry *lru = NULL; // least recently used, evicted first
+static int entry_ct = 0;
+static int capacity = DEFAULT_CAPACITY;
+
+static unsigned long hits = 0;
+static unsigned long misses = 0;
+static unsigned long evictions = 0;
+
+static unsigned long hash_line (const char *, size_t);
+static cmd_entry* find_entry (unsigned long, const char *, size_t);
+static cmd_entry* new_entry ();
+static bool parse_entry (cmd_entry *, const char *, size_t);
+static void drop_entry (cmd_entry *);
+static void free_entry (cmd_entry *);
+static void unlink_entry (cmd_entry *);
+static void push_front (cmd_entry *);
+
+/**
+ * gets the tokenized and split form of a line, from the cache if it
+ * was seen recently, otherwise by tokenizing it and caching the result.
+ * Returns NULL if the line has no tokens. The entry must not be changed
+ * and has to be given back with cmd_cache_put when done with it
+ */
+const cmd_entry *cmd_cache_get (const char *line, size_t len)
+{
+    unsigned long hash = hash_line(line, len);
+    cmd_entry *e = find_entry(hash, line, len);
+    if (e != NULL) {
+        hits++;
+        trace_count(CNT_CMD_HITS);
+        unlink_entry(e);
+        push_front(e);
+        e->refs++;
+        return e;
+    }
+    misses++;
+    trace_count(CNT_CMD_MISSES);
+
+    e = new_entry();
+    if (!parse_entry(e, line, len)) {
+        free_entry(e);
+        return NULL;
+    }
+    e->hash = hash;
+    e->refs = 1;
+
+    if (capacity == 0) { // not cached, freed when it is put back
+        e->dead = true;
+        return e;
+    }
+
+    if (bucket_ct == 0) {
+        cmd_cache_resize(capacity);
+    }
+    if (entry_ct >= capacity) {
+        drop_entry(lru);
+        evictions++;
+    }
+    push_front(e);
+    return e;
+}
+
+/**
+ * gives back an entry from cmd_cache_get
+ */
+void cmd_cache_put (const cmd_entry *entry)
+{
+    cmd_entry *e = (cmd_entry *)entry;
+    e->refs--;
+    if (e->refs == 0 && e->dead) {
+        free_entry(e);
+    }
+}
+
+/**
+ * sets how many lines are kept, dropping the least recently used ones
+ * if there are too many. 0 turns the cache off
+ */
+void cmd_cache_resize (int size)
+{
+    if (size < 0) {
+        size = 0;
+    }
+    capacity = size;
+    while (entry_ct > capacity) {
+        drop_entry(lru);
+        evictions++;
+    }
+
+    /* keep about two buckets per entry */
+    size_t new_ct = 16;
+    while (new_ct < (size_t)capacity * 2) {
+        new_ct *= 2;
+    }
+    cmd_entry **new_buckets = calloc(new_ct, sizeof(cmd_entry *));
+    if (new_buckets == NULL) {
+        perror("malloc failed in cmd_cache_resize");
+        exit(-1);
+    }
+    for (cmd_entry *e = mru; e != NULL; e = e->next) {
+        size_t slot = e->hash & (new_ct - 1);
+        e->chain = new_buckets[slot];
+        new_buckets[slot] = e;
+    }
+    free(buckets);
+    buckets = new_buckets;
+    bucket_ct = new_ct;
+}
+
+/**
+ * forgets every cached line and resets the counters
+ */
+void cmd_cache_clear ()
+{
+    while (mru != NULL) {
+        drop_entry(mru);
+    }
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+/**
+ * prints how full the cache is and how well it is doing
+ */
+void cmd_cache_print ()
+{
+    unsigned long lookups = hits + misses;
+    printf("entries   %d/%d\n", entry_ct, capacity);
+    printf("hits      %lu\n", hits);
+    printf("misses    %lu\n", misses);
+    printf("evictions %lu\n", evictions);
+    printf("hit rate  %.1f%%\n", lookups ? 100.0 * hits / lookups : 0.0);
+}
+
+/**
+ * FNV-1a hash of the line
+ */
+static unsigned long hash_line (const char *line, size_t len)
+{
+    unsigned long h = 14695981039346656037UL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)line[i];
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+/**
+ * finds the cached entry for the line, NULL if there isn't one
+ */
+static cmd_entry* find_entry (unsigned long hash, const char *line, size_t len)
+{
+    if (bucket_ct == 0) {
+        return NULL;
+    }
+    cmd_entry *e = buckets[hash & (bucket_ct - 1)];
+    while (e != NULL) {
+        if (e->hash == hash && e->len == len && !memcmp(e->line, line, len)) {
+            return e;
+        }
+        e = e->chain;
+    }
+    return NULL;
+}
+
+/**
+ * makes an empty entry with its own arena
+ */
+static cmd_entry* new_entry ()
+{
+    cmd_entry *e = calloc(1, sizeof(cmd_entry));
+    if (e == NULL) {
+        perror("malloc failed in new_entry");
+        exit(-1);
+    }
+    init_tok_list(&e->tlist);
+    return e;
+}
+
+/**
+ * copies the line into the entry's arena, tokenizes it and splits it
+ * into stages. Returns false if there were no tokens
+ */
+static bool parse_entry (cmd_entry *e, const char *line, size_t len)
+{
+    e->line = arena_alloc(e->tlist.mem, len + 1);
+    memcpy(e->line, line, len);
+    e->line[len] = '\0';
+    e->len = len;
+
+    uint64_t t = trace_start();
+    tokenize(&e->tlist, e->line, len);
+    if (e->tlist.count == 0) {
+        trace_stop(PH_TOKENIZE, t);
+        return false;
+    }
+    build_pipeline(e->tlist, &e->pl);
+    e->builtin = is_shell_line(e->tlist, &e->pl);
+    trace_stop(PH_TOKENIZE, t);
+    return true;
+}
+
+/**
+ * takes an entry out of the cache. It is freed now, or when the
+ * last user puts it back
+ */
+static void drop_entry (cmd_entry *e)
+{
+    unlink_entry(e);
+    if (e->refs > 0) {
+        e->dead = true;
+    } else {
+        free_entry(e);
+    }
+}
+
+/**
+ * frees an entry that is no longer linked
+ */
+static void free_entry (cmd_entry *e)
+{
+    destroy_tok_list(&e->tlist);
+    free(e);
+}
+
+/**
+ * takes an entry out of its bucket and the recency list
+ */
+static void unlink_entry (cmd_entry *e)
+{
+    cmd_entry **link = &buckets[e->hash & (bucket_ct - 1)];
+    while (*link != e) {
+        link = &(*link)->chain;
+    }
+    *link = e->chain;
+
+    if (e->prev) {
+        e->prev->next = e->next;
+    } else {
+        mru = e->next;
+    }
+    if (e->next) {
+        e->next->prev = e->prev;
+    } else {
+        lru = e->prev;
+    }
+    entry_ct--;
+}
+
+/**
+ * adds an entry to its bucket and makes it the most recently used
+ */
+static void push_front (cmd_entry *e)
+{
+    size_t slot = e->hash & (bucket_ct - 1);
+    e->chain = buckets[slot];
+    buckets[slot] = e;
+
+    e->prev = NULL;
+    e->next = mru;
+    if (mru) {
+        mru->prev = e;
+    } else {
+        lru = e;
+    }
+    mru = e;
+    entry_ct++;
+}
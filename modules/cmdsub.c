@@ -0,0 +1,259 @@
+/************************************************
+ *                  cmdsub.c                    *
+ ************************************************
+ * cmdsub runs the command of a $(cmd) and      *
+ * captures its output. Builtins that only      *
+ * print run in the shell with stdout on a      *
+ * memfd, anything else writes into a pipe      *
+ * read into a buffer that grows with mremap,   *
+ * so the output is never copied around again   *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#define _GNU_SOURCE
+
+#include "../includes/cmdsub.h"
+#include "../includes/cmdcache.h"
+#include "../includes/dispatch.h"
+#include "../includes/executor.h"
+#include "../includes/internal.h"
+#include "../includes/procsub.h"
+#include "../includes/jobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define FIRST_READ 65536
+#define PIPE_BYTES (1 << 20) // asked for, the kernel may give less
+
+typedef struct {
+    char *buf;
+    size_t size;
+} held_map;
+
+/* outputs still in use by the lines that captured them */
+static held_map *held = NULL;
+static int held_ct = 0;
+static int held_cap = 0;
+
+static char *capture_in_shell (const char *, size_t, size_t *);
+static char *capture_stage (const stage *, size_t *);
+static char *capture_subshell (const char *, size_t, size_t *);
+static char *read_all (int, size_t *);
+static void hold (char *, size_t);
+
+/**
+ * runs cmd, len bytes without a \n, and returns everything it wrote to
+ * stdout, setting out_len. The buffer has a spare byte after the output
+ * for a \0 and may be written to. It stays until cmdsub_release, or is
+ * NULL if there was no output
+ */
+char *cmdsub_capture (const char *cmd, size_t len, size_t *out_len)
+{
+    *out_len = 0;
+    char *line = malloc(len + 1);
+    if (line == NULL) {
+        perror("malloc failed in cmdsub_capture");
+        exit(-1);
+    }
+    memcpy(line, cmd, len);
+    line[len] = '\n';
+
+    char *out = NULL;
+    const cmd_entry *e = cmd_cache_get(line, len + 1);
+    if (e != NULL) {
+        const pipeline *pl = &e->pl;
+        bool simple = pl->count == 1 && !pl->background && pl->substs == 0 &&
+            pl->expands == 0 && pl->here_docs == 0;
+        if (e->builtin && is_pure_line(e->tlist, pl)) {
+            out = capture_in_shell(line, len + 1, out_len);
+        } else if (!e->builtin && simple) {
+            out = capture_stage(&pl->stages[0], out_len);
+        } else {
+            out = capture_subshell(line, len, out_len);
+        }
+        cmd_cache_put(e);
+    }
+    free(line);
+    return out;
+}
+
+/**
+ * the number of outputs held, to give cmdsub_release so a line run
+ * inside another one only lets go of its own
+ */
+int cmdsub_mark ()
+{
+    return held_ct;
+}
+
+/**
+ * unmaps every output captured since mark
+ */
+void cmdsub_release (int mark)
+{
+    for (int i = mark; i < held_ct; i++) {
+        munmap(held[i].buf, held[i].size);
+    }
+    held_ct = mark;
+}
+
+/**
+ * runs a builtin line in the shell with stdout on a memfd, then maps
+ * the memfd. Nothing is forked and the output is only written once
+ */
+static char *capture_in_shell (const char *line, size_t len, size_t *out_len)
+{
+    int mfd = memfd_create("command-substitution", MFD_CLOEXEC);
+    if (mfd < 0) {
+        perror("memfd_create failed for command substitution");
+        return NULL;
+    }
+    fflush(stdout);
+    int saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+    dup2(mfd, STDOUT_FILENO);
+    run_line(line, len, NULL, NULL);
+    fflush(stdout);
+    if (saved >= 0) {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    } else {
+        close(STDOUT_FILENO);
+    }
+
+    struct stat st;
+    if (fstat(mfd, &st) < 0 || st.st_size == 0 ||
+        ftruncate(mfd, st.st_size + 1) < 0) { // room for a \0
+        close(mfd);
+        return NULL;
+    }
+    /* shared, so splitting it in place writes to the memfd's own pages */
+    char *buf = mmap(NULL, st.st_size + 1, PROT_READ | PROT_WRITE,
+        MAP_SHARED, mfd, 0);
+    close(mfd);
+    if (buf == MAP_FAILED) {
+        perror("mmap failed for command substitution");
+        return NULL;
+    }
+    hold(buf, st.st_size + 1);
+    *out_len = st.st_size;
+    return buf;
+}
+
+/**
+ * launches a single command straight from the shell with its stdout
+ * on a pipe, and reads the pipe until it closes
+ */
+static char *capture_stage (const stage *st, size_t *out_len)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        perror("pipe failed for command substitution");
+        return NULL;
+    }
+    fcntl(fds[1], F_SETPIPE_SZ, PIPE_BYTES);
+    int status;
+    pid_t pid = launch_stage(st, -1, fds[1], &status);
+    close(fds[1]);
+    char *out = read_all(fds[0], out_len);
+    close(fds[0]);
+    if (pid >= 0) {
+        cmd_usage usage;
+        acct_start(&usage);
+        wait_stages(&pid, &status, &usage, 1, false);
+    }
+    return out;
+}
+
+/**
+ * runs anything else, pipelines and builtins that change the shell,
+ * in a subshell with its stdout on a pipe
+ */
+static char *capture_subshell (const char *cmd, size_t len, size_t *out_len)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        perror("pipe failed for command substitution");
+        return NULL;
+    }
+    fcntl(fds[1], F_SETPIPE_SZ, PIPE_BYTES);
+    pid_t pid = subshell(cmd, len, fds[1], STDOUT_FILENO, false);
+    close(fds[1]);
+    char *out = read_all(fds[0], out_len);
+    close(fds[0]);
+    if (pid >= 0) {
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+    }
+    return out;
+}
+
+/**
+ * reads fd to EOF into anonymous memory, doubling it with mremap when
+ * it fills so the pages already read are moved, not copied. Each read
+ * asks for all the room left. NULL if nothing was read
+ */
+static char *read_all (int fd, size_t *out_len)
+{
+    size_t cap = FIRST_READ;
+    size_t len = 0;
+    char *buf = mmap(NULL, cap, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        perror("mmap failed for command substitution");
+        return NULL;
+    }
+    for (;;) {
+        if (cap - len < 2) { // always a byte spare for a \0
+            char *bigger = mremap(buf, cap, cap * 2, MREMAP_MAYMOVE);
+            if (bigger == MAP_FAILED) {
+                perror("mremap failed for command substitution");
+                break;
+            }
+            buf = bigger;
+            cap *= 2;
+        }
+        ssize_t got = read(fd, buf + len, cap - len - 1);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        } else if (got <= 0) {
+            break;
+        }
+        len += got;
+    }
+    if (len == 0) {
+        munmap(buf, cap);
+        return NULL;
+    }
+    hold(buf, cap);
+    *out_len = len;
+    return buf;
+}
+
+/**
+ * remembers a mapping to unmap in cmdsub_release
+ */
+static void hold (char *buf, size_t size)
+{
+    if (held_ct == held_cap) {
+        int cap = held_cap ? held_cap * 2 : 8;
+        held_map *tmp = realloc(held, sizeof(held_map) * cap);
+        if (tmp == NULL) {
+            perror("realloc failed in hold");
+            exit(-1);
+        }
+        held = tmp;
+        held_cap = cap;
+    }
+    held[held_ct].buf = buf;
+    held[held_ct].size = size;
+    held_ct++;
+}
@@ -0,0 +1,314 @@
+/************************************************
+ *                  dirlist.c                   *
+ ************************************************
+ * dirlist reads whole directories with raw     *
+ * getdents64 calls into a big buffer, and      *
+ * keeps the sorted listings of recently read   *
+ * ones keyed on device, inode and mtime, so    *
+ * globbing an unchanged directory again costs  *
+ * one stat                                     *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/dirlist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define DENT_BUF_SIZE (1 << 20) // bytes asked of each getdents64
+#define CACHE_SLOTS 256 // directories cached, a power of 2
+#define CACHE_BYTES (64 << 20) // memory the cached listings may hold
+/* mtime comes from a clock coarser than the file system's stamps, so
+ * a directory changed this recently may change again without its mtime
+ * moving. Its listing is used once and not cached */
+#define MTIME_SLACK_NS 20000000L
+
+/* what getdents64 fills its buffer with */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static dir_list *slots[CACHE_SLOTS]; // direct mapped by device and inode
+static size_t cached_bytes = 0;
+static char *dent_buf = NULL;
+static const char *sort_names; // names being sorted, for cmp_entry
+
+static unsigned int slot_of (dev_t, ino_t);
+static bool settled (const struct timespec *);
+static dir_list *read_dir (int, const struct stat *);
+static void cache_list (dir_list *, unsigned int);
+static void drop_slot (unsigned int);
+static void free_list (dir_list *);
+static int cmp_entry (const void *, const void *);
+
+/**
+ * the listing of the directory at path, sorted by name and without .
+ * and .. in it. It comes from the cache if the directory hasn't
+ * changed since it was read. NULL if it can't be read. It must not be
+ * changed and has to be given back with dir_list_put
+ */
+const dir_list *dir_list_get (const char *path)
+{
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    unsigned int slot = slot_of(st.st_dev, st.st_ino);
+    dir_list *dl = slots[slot];
+    if (dl != NULL && dl->dev == st.st_dev && dl->ino == st.st_ino &&
+        dl->mtime.tv_sec == st.st_mtim.tv_sec &&
+        dl->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        close(fd);
+        dl->refs++;
+        return dl;
+    }
+
+    dl = read_dir(fd, &st);
+    close(fd);
+    if (dl == NULL) {
+        return NULL;
+    }
+    if (settled(&st.st_mtim)) {
+        cache_list(dl, slot);
+    }
+    return dl;
+}
+
+/**
+ * gives back a listing from dir_list_get. One that was dropped from the
+ * cache meanwhile is freed by its last user
+ */
+void dir_list_put (const dir_list *cdl)
+{
+    dir_list *dl = (dir_list *)cdl;
+    if (--dl->refs == 0 && !dl->cached) {
+        free_list(dl);
+    }
+}
+
+/**
+ * true if entry i of the listing of dir is a directory. Symlinks to
+ * directories count if follow. The type getdents64 gave is trusted,
+ * names whose type it didn't know are stat'd
+ */
+bool dir_list_is_dir (const dir_list *dl, const char *dir, int i,
+    bool follow)
+{
+    unsigned char type = dl->types[i];
+    if (type == DT_DIR) {
+        return true;
+    }
+    if (type != DT_UNKNOWN && (type != DT_LNK || !follow)) {
+        return false;
+    }
+    char path[PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/%s", dir,
+        dl->names + dl->order[i]);
+    if (n >= (int)sizeof(path)) {
+        return false;
+    }
+    struct stat st;
+    return fstatat(AT_FDCWD, path, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW)
+        == 0 && S_ISDIR(st.st_mode);
+}
+
+/**
+ * the cache slot for a directory
+ */
+static unsigned int slot_of (dev_t dev, ino_t ino)
+{
+    unsigned long h = (unsigned long)ino * 0x9E3779B97F4A7C15UL ^
+        (unsigned long)dev;
+    return (h >> 32) & (CACHE_SLOTS - 1);
+}
+
+/**
+ * true if an mtime is far enough in the past that a listing read now
+ * can be trusted for as long as the mtime stays the same
+ */
+static bool settled (const struct timespec *mtime)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long long age = (long long)(now.tv_sec - mtime->tv_sec) * 1000000000LL +
+        (now.tv_nsec - mtime->tv_nsec);
+    return age > MTIME_SLACK_NS;
+}
+
+/**
+ * reads every name in the open directory fd with getdents64 and sorts
+ * them. Returns the listing with one user, or NULL if it failed
+ */
+static dir_list *read_dir (int fd, const struct stat *st)
+{
+    if (dent_buf == NULL && (dent_buf = malloc(DENT_BUF_SIZE)) == NULL) {
+        perror("malloc failed in read_dir");
+        exit(-1);
+    }
+    size_t name_cap = 4096, name_len = 0;
+    size_t ent_cap = 256, ent_ct = 0;
+    char *names = malloc(name_cap);
+    /* offset << 8 | type, so one sort keeps each type with its name */
+    uint64_t *ents = malloc(sizeof(uint64_t) * ent_cap);
+    if (names == NULL || ents == NULL) {
+        perror("malloc failed in read_dir");
+        exit(-1);
+    }
+
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, dent_buf, DENT_BUF_SIZE);
+        if (n < 0) {
+            free(names);
+            free(ents);
+            return NULL;
+        }
+        if (n == 0) {
+            break;
+        }
+        for (long pos = 0; pos < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(dent_buf + pos);
+            pos += d->d_reclen;
+            const char *name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' ||
+                (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            size_t len = strlen(name) + 1;
+            if (name_len + len > name_cap) {
+                while (name_len + len > name_cap) {
+                    name_cap *= 2;
+                }
+                if ((names = realloc(names, name_cap)) == NULL) {
+                    perror("realloc failed in read_dir");
+                    exit(-1);
+                }
+            }
+            if (ent_ct == ent_cap) {
+                ent_cap *= 2;
+                if ((ents = realloc(ents, sizeof(uint64_t) * ent_cap)) == NULL) {
+                    perror("realloc failed in read_dir");
+                    exit(-1);
+                }
+            }
+            memcpy(names + name_len, name, len);
+            ents[ent_ct++] = (uint64_t)name_len << 8 | d->d_type;
+            name_len += len;
+        }
+    }
+
+    sort_names = names;
+    qsort(ents, ent_ct, sizeof(uint64_t), cmp_entry);
+
+    /* names are copied out in sorted order, so walking the listing
+     * reads memory front to back */
+    dir_list *dl = malloc(sizeof(dir_list));
+    char *sorted = malloc(name_len + 1);
+    uint32_t *order = malloc(sizeof(uint32_t) * (ent_ct + 1));
+    unsigned char *types = malloc(ent_ct + 1);
+    if (dl == NULL || sorted == NULL || order == NULL || types == NULL) {
+        perror("malloc failed in read_dir");
+        exit(-1);
+    }
+    size_t pos = 0;
+    for (size_t i = 0; i < ent_ct; i++) {
+        const char *name = names + (ents[i] >> 8);
+        size_t len = strlen(name) + 1;
+        memcpy(sorted + pos, name, len);
+        order[i] = pos;
+        types[i] = ents[i] & 0xff;
+        pos += len;
+    }
+    order[ent_ct] = pos;
+    free(ents);
+    free(names);
+
+    dl->names = sorted;
+    dl->order = order;
+    dl->types = types;
+    dl->count = ent_ct;
+    dl->dev = st->st_dev;
+    dl->ino = st->st_ino;
+    dl->mtime = st->st_mtim;
+    dl->bytes = name_len + ent_ct * (sizeof(uint32_t) + 1);
+    dl->refs = 1;
+    dl->cached = false;
+    return dl;
+}
+
+/**
+ * puts a listing in its slot, in place of whatever was there. When the
+ * cache holds too much every listing no one is using is dropped first,
+ * and if that isn't enough this one isn't cached
+ */
+static void cache_list (dir_list *dl, unsigned int slot)
+{
+    drop_slot(slot);
+    if (cached_bytes + dl->bytes > CACHE_BYTES) {
+        for (unsigned int i = 0; i < CACHE_SLOTS; i++) {
+            if (slots[i] != NULL && slots[i]->refs == 0) {
+                drop_slot(i);
+            }
+        }
+        if (cached_bytes + dl->bytes > CACHE_BYTES) {
+            return;
+        }
+    }
+    slots[slot] = dl;
+    dl->cached = true;
+    cached_bytes += dl->bytes;
+}
+
+/**
+ * takes a listing out of the cache. It is freed now, or when the last
+ * user puts it back
+ */
+static void drop_slot (unsigned int slot)
+{
+    dir_list *dl = slots[slot];
+    if (dl == NULL) {
+        return;
+    }
+    slots[slot] = NULL;
+    cached_bytes -= dl->bytes;
+    dl->cached = false;
+    if (dl->refs == 0) {
+        free_list(dl);
+    }
+}
+
+/**
+ * frees a listing
+ */
+static void free_list (dir_list *dl)
+{
+    free(dl->names);
+    free(dl->order);
+    free(dl->types);
+    free(dl);
+}
+
+/**
+ * orders entries by name
+ */
+static int cmp_entry (const void *a, const void *b)
+{
+    return strcmp(sort_names + (*(const uint64_t *)a >> 8),
+        sort_names + (*(const uint64_t *)b >> 8));
+}
@@ -0,0 +1,226 @@
+/************************************************
+ *                 dispatch.c                   *
+ ************************************************
+ * dispatch runs one line of input, either as   *
+ * an internal command or through the executor. *
+ * Lines are tokenized through the command      *
+ * cache so repeated lines are only split once, *
+ * script lines are tokenized in place instead. *
+ * Here document bodies are read from the lines *
+ * that follow, and substitutions are done      *
+ * each time the line runs                      *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/dispatch.h"
+#include "../includes/cmdcache.h"
+#include "../includes/executor.h"
+#include "../includes/internal.h"
+#include "../includes/tokenizer.h"
+#include "../includes/pipeline.h"
+#include "../includes/jobs.h"
+#include "../includes/trace.h"
+#include "../includes/procsub.h"
+#include "../includes/cmdsub.h"
+#include "../includes/expand.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+static void run_tokens (ListHandler, const pipeline *, bool);
+static void run_here_docs (ListHandler, bool, next_line, void *);
+static void run_expanded (ListHandler, const pipeline *);
+static char *read_body (const char *, next_line, void *, arena *);
+
+/* exit status of the last line run, 1 for a builtin that failed */
+static int status = 0;
+
+/* token list reused by every in place line */
+static ListHandler scratch;
+static bool scratch_init = false;
+
+/**
+ * tokenizes a line (or finds it in the command cache) and runs it.
+ * Here document bodies are taken from more, which may invalidate line
+ */
+void run_line (const char *line, size_t len, next_line more, void *src)
+{
+    trace_line_begin();
+    const cmd_entry *e = cmd_cache_get(line, len);
+    if (e == NULL) { // nothing to run or it didn't tokenize
+        trace_line_end(line, len);
+        return;
+    }
+    if (e->pl.here_docs > 0) {
+        run_here_docs(e->tlist, e->builtin, more, src);
+    } else {
+        run_tokens(e->tlist, &e->pl, e->builtin);
+    }
+    trace_line_end(e->line, e->len);
+    cmd_cache_put(e);
+}
+
+/**
+ * tokenizes a line in place and runs it without going through the
+ * command cache. The tokens point into line, which gets \0s written
+ * into it, so it must be writable and can't be run again
+ */
+void run_line_in_place (char *line, size_t len, next_line more, void *src)
+{
+    if (!scratch_init) {
+        init_tok_list(&scratch);
+        scratch_init = true;
+    }
+    trace_line_begin();
+    uint64_t t = trace_start();
+    tokenize_in_place(&scratch, line, len);
+    if (scratch.count > 0) {
+        pipeline pl;
+        build_pipeline(scratch, &pl);
+        bool builtin = is_shell_line(scratch, &pl);
+        trace_stop(PH_TOKENIZE, t);
+        if (pl.here_docs > 0) {
+            run_here_docs(scratch, builtin, more, src);
+        } else {
+            run_tokens(scratch, &pl, builtin);
+        }
+    } else {
+        trace_stop(PH_TOKENIZE, t);
+    }
+    free_tok_list(&scratch);
+    trace_line_end(line, len); // its \0s are traced as spaces
+}
+
+/**
+ * the exit status of the last line run
+ */
+int last_status ()
+{
+    return status;
+}
+
+/**
+ * runs a tokenized line in the shell as an internal command or through
+ * the executor. Background jobs that finished meanwhile are reaped first
+ */
+static void run_tokens (ListHandler tlist, const pipeline *pl, bool builtin)
+{
+    jobs_update();
+    procsub_reap();
+    if (pl->substs > 0 || pl->expands > 0) {
+        run_expanded(tlist, pl);
+    } else if (builtin) {
+        /* builtins always run in the shell, so a trailing & is dropped */
+        if (tlist.head[tlist.count-1].special &&
+            !strcmp(tlist.head[tlist.count-1].token, "&")) {
+            tlist.count--;
+        }
+        uint64_t t = trace_start();
+        status = 0;
+        if (run_internal_cmd(tlist) < 0) {
+            fprintf(stderr, "Unable to run internal command\n");
+            status = 1;
+        }
+        trace_stop(PH_BUILTIN, t);
+    } else {
+        status = execute(pl);
+    }
+}
+
+/**
+ * reads the body of each here document in tlist, in order, then runs
+ * a copy of tlist with every delimiter swapped for its body. tlist
+ * itself is left alone, as it may be cached
+ */
+static void run_here_docs (ListHandler tlist, bool builtin, next_line more,
+    void *src)
+{
+    arena mem = {NULL};
+    tok_node *head = arena_alloc(&mem, sizeof(tok_node) * tlist.count);
+    memcpy(head, tlist.head, sizeof(tok_node) * tlist.count);
+    for (int i = 0; i + 1 < tlist.count; i++) {
+        if (head[i].special && !strcmp(head[i].token, "<<")) {
+            i++;
+            head[i].token = read_body(head[i].token, more, src, &mem);
+        }
+    }
+
+    ListHandler bodies = tlist;
+    bodies.head = head;
+    bodies.cap = 0;
+    bodies.mem = &mem;
+    pipeline pl;
+    build_pipeline(bodies, &pl);
+    run_tokens(bodies, &pl, builtin);
+    arena_free(&mem);
+}
+
+/**
+ * runs a copy of tlist with its substitutions done: <(cmd) and >(cmd)
+ * are started and swapped for /dev/fd/n, n being the shell's end of
+ * the pipe to them, and $(cmd) for its output. The pipes are closed
+ * and the outputs dropped once the line is done, and in the foreground
+ * the >(cmd)s are waited for
+ */
+static void run_expanded (ListHandler tlist, const pipeline *pl)
+{
+    arena mem = {NULL};
+    ListHandler words = {NULL, 0, 0, &mem};
+    int subs = procsub_mark();
+    int outputs = cmdsub_mark();
+    bool started = expand_tokens(tlist, &words);
+    status = started ? 0 : 1;
+    if (started && words.count > 0) {
+        pipeline expanded;
+        build_pipeline(words, &expanded);
+        /* the words are final, marks in them came from substituted text
+         * and are just chars */
+        expanded.substs = 0;
+        expanded.expands = 0;
+        run_tokens(words, &expanded, is_shell_line(words, &expanded));
+    }
+    procsub_close(subs, started && !pl->background);
+    cmdsub_release(outputs);
+    arena_free(&mem);
+}
+
+/**
+ * collects lines from more up to one that is just delim, which is
+ * dropped. Running out of lines first ends the body there too, with a
+ * warning. The body is \0 terminated and allocated in mem
+ */
+static char *read_body (const char *delim, next_line more, void *src,
+    arena *mem)
+{
+    size_t delim_len = strlen(delim);
+    size_t len = 0;
+    size_t cap = 256;
+    char *body = arena_alloc(mem, cap);
+    char *line;
+    ssize_t n = -1;
+    while (more != NULL && (n = more(src, &line)) >= 0) {
+        size_t text = (n > 0 && line[n-1] == '\n') ? n - 1 : n;
+        if (text == delim_len && !memcmp(line, delim, text)) {
+            break;
+        }
+        if (len + text + 2 > cap) {
+            while (len + text + 2 > cap) {
+                cap *= 2;
+            }
+            char *tmp = arena_alloc(mem, cap);
+            memcpy(tmp, body, len);
+            body = tmp;
+        }
+        memcpy(body + len, line, text);
+        len += text;
+        body[len++] = '\n';
+    }
+    if (n < 0) {
+        fprintf(stderr, "here document ended by end of input, "
+            "wanted %s\n", delim);
+    }
+    body[len] = '\0';
+    return body;
+}
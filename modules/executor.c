@@ -1,373 +1,780 @@
 /************************************************
  *                 executor.c                   *
  ************************************************
- * executor takes a linked list and runs the    *
- * strings stored in it as (a) command(s)       *
+ * executor takes a list of tokens and runs    *
+ * the strings stored in it as (a) command(s)   *
  ************************************************
  * Author: Justin Weigle                        *
  * Edited: 30 Jul 2020                          *
  ************************************************/
 
+#define _GNU_SOURCE
+
 #include "../includes/executor.h"
 #include "../includes/mycli.h"
+#include "../includes/pathcache.h"
+#include "../includes/jobs.h"
+#include "../includes/trace.h"
+#include "../includes/internal.h"
+#include "../includes/meter.h"
+#include "../includes/procsub.h"
+#include "../includes/vars.h"
+#include "../includes/batch.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
-#include <dirent.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
 
-typedef struct path_node {
-    char *path;
-    struct path_node *next;
-} path_node;
-
-enum Read_Write {
-    READ,
-    WRITE
-};
-
-static void parse_cmd (ListHandler);
-static ListHandler get_next_subsection (tok_node *);
-static bool bin_exists (char *);
-static int count_pipes (tok_node *);
+static const char* resolve_cmd (const stage *);
 static int get_fd (char *, enum Read_Write, bool);
-static void output_to_file (char *, bool);
-static void file_to_input (char *);
-static path_node* get_path();
-static void save_path(char *, path_node **);
-static void free_path (path_node *);
+static int here_fd (const char *, bool);
+static bool write_all (int, const char *, size_t);
+static pid_t start_stage (const stage *, int, int, pid_t, bool, bool, int *);
+static bool use_spawn (bool);
+static pid_t launch_spawn (const stage *, const char *, int, int, pid_t, bool);
+static pid_t launch_fork (const stage *, const char *, int, int, pid_t, bool);
+static pid_t launch_builtin (const stage *, int, int, pid_t, bool);
+static pid_t launch_batches (const stage *, const char *, int, int, int,
+    pid_t, bool);
+static void setup_child (int, int, pid_t, bool);
+static void close_exec_fds ();
+static bool owns_terminal ();
+static bool is_plain_cat (const stage *);
+static void make_pipe (int *, long);
+static long pipe_capacity (const pipeline *);
+static long pipe_max_size ();
+static int wait_foreground (const pipeline *, pid_t, pid_t *, int);
+
+/* exit status and resources used by each stage of the last pipeline */
+static int *stage_status = NULL;
+static cmd_usage *stage_usage = NULL;
+static int status_cap = 0;
+static int stage_ct = 0;
+static int stage_first = 0; // stages of the caller's pipeline not run
 
 /**
- * Counts how many pipes there are in the given linked list of tokens and
- * forks() a process for each command and pipes between them as necessary
+ * Launches a process for each stage of the pipeline and pipes between
+ * them as necessary. All stages run at the same time in one process
+ * group, and the exit status of the last stage is returned. Pipelines
+ * ending in & are added to the job table instead of waited on
  */
-void execute (tok_node *head)
+int execute (const pipeline *pl)
 {
-    /* find number of pipes in linked list */
-    int pipe_ct = count_pipes(head);
-    int cmd_ct = pipe_ct + 1;
+    /* cat file | cmd... runs as cmd... < file, so the first command reads
+     * the file itself instead of through a cat and a pipe. Its own < still
+     * wins, being later */
+    if (pl->count > 1 && is_plain_cat(&pl->stages[0])) {
+        stage rest[pl->count - 1];
+        memcpy(rest, pl->stages + 1, sizeof(stage) * (pl->count - 1));
+        redirect redirs[rest[0].redir_ct + 1];
+        redirs[0].rw = READ;
+        redirs[0].append = false;
+        redirs[0].file = pl->stages[0].argv[1];
+        memcpy(redirs + 1, rest[0].redirs, sizeof(redirect) * rest[0].redir_ct);
+        rest[0].redirs = redirs;
+        rest[0].redir_ct++;
+        pipeline shorter = *pl;
+        shorter.stages = rest;
+        shorter.count--;
+        int status = execute(&shorter);
+        stage_first = 1; // the cat ran as a redirect, not a stage
+        return status;
+    }
 
-    /* allocate storage for the cmd(s) */
-    ListHandler cmds[cmd_ct];
+    int cmd_ct = pl->count;
+    int pipe_ct = cmd_ct - 1;
+    const stage *stages = pl->stages;
 
-    /* split input into separate cmds if pipe(s) */
-    tok_node *curr = head;
-    for (int i = 0; i < cmd_ct; i++) {
-        cmds[i] = get_next_subsection(curr);
-        curr = cmds[i].tail;
-        if(curr->next != NULL) { // move to next non pipe token
-            curr = curr->next->next;
+    /* create variables for pipes */
+    int pipefd[cmd_ct][2]; // one spare so the array is never empty
+    int relayfd[cmd_ct][2]; // relay to reader, when metering
+    long pipe_size = pipe_capacity(pl);
+    bool metered = pipe_ct > 0 && !pl->background &&
+        (pl->meter || var_get("MYCLI_PIPE_METER") != NULL);
+
+    /* create the pipes. close-on-exec so each child only keeps the
+     * ends it gets on stdin/stdout. Metered pipes are two pipes with the
+     * relay between, stage i writes pipefd[i] and i+1 reads relayfd[i] */
+    for (int i = 0; i < pipe_ct; i++) {
+        make_pipe(pipefd[i], pipe_size);
+        if (metered) {
+            make_pipe(relayfd[i], pipe_size);
         }
     }
+    int (*readfd)[2] = metered ? relayfd : pipefd;
 
-    /* create variables for pipes */
-    int pipefd[pipe_ct][2];
-
-    /* create the pipes */
-    for (int i = 0; i < pipe_ct; i++) {
-        if (pipe(pipefd[i]) < 0) {
-            perror("pipe failed in execute");
+    if (status_cap < cmd_ct) {
+        int *tmp = realloc(stage_status, sizeof(int) * cmd_ct);
+        cmd_usage *utmp = realloc(stage_usage, sizeof(cmd_usage) * cmd_ct);
+        if (tmp == NULL || utmp == NULL) {
+            perror("realloc failed in execute");
+            exit(-1);
         }
+        stage_status = tmp;
+        stage_usage = utmp;
+        status_cap = cmd_ct;
     }
+    stage_ct = cmd_ct;
+    stage_first = 0;
 
-    /* for forks */
-    int status;
-    pid_t pid;
+    pid_t pids[cmd_ct];
+    pid_t pgid = 0; // every stage joins the first stage's process group
+    bool fg_tty = !pl->background && owns_terminal();
+    bool spawn = use_spawn(fg_tty);
 
-    /* fork for every cmd in input */
+    /* launch every cmd in input before waiting on any of them */
     for (int i = 0; i < cmd_ct; i++) {
-        fflush(NULL); // flush all open output streams(especially pipes)
-        pid = fork();
-        if (pid < 0) {
-            perror("fork failed in execute");
-            exit(-1);
-        } else if (pid == 0) { // child
-            signal(SIGINT, SIG_DFL);
-            if (i > 0) { // if not the first cmd
-                /* connect read end of prev proc pipe to STDIN of curr proc */
-                if (dup2(pipefd[i-1][0], STDIN_FILENO) < 0) {
-                    perror("dup2 failed in execute");
-                }
-                close(pipefd[i-1][0]); // close read end prev proc pipe
-                close(pipefd[i-1][1]); // close write end prev proc pipe
-            }
-            if (i+1 < cmd_ct) { // if there is a next command
-                close(pipefd[i][0]); // close read end of curr proc pipe
-                /* connect write end of curr proc pipe to STDOUT */
-                if (dup2(pipefd[i][1], STDOUT_FILENO) < 0) {
-                    perror("dup2 failed in execute");
-                }
-                close(pipefd[i][1]); // close write end curr proc pipe
+        int in_fd = (i > 0) ? readfd[i-1][0] : -1;
+        int out_fd = (i+1 < cmd_ct) ? pipefd[i][1] : -1;
+        acct_start(&stage_usage[i]);
+        pids[i] = start_stage(&stages[i], in_fd, out_fd, pgid, fg_tty, spawn,
+            &stage_status[i]);
+        if (pids[i] >= 0) {
+            /* set the group here too so it exists before we wait on it */
+            if (pgid == 0) {
+                pgid = pids[i];
             }
-            parse_cmd(cmds[i]); // parse and exec curr command
-            perror("exec failed"); // if parse_cmd returns, error
-            exit(-1);
-        } else { // parent
-            if (i > 0) { // make sure prev proc pipes are closed
-                close(pipefd[i-1][0]); // close read end prev proc pipe
-                close(pipefd[i-1][1]); // close write end prev proc pipe
+            setpgid(pids[i], pgid);
+        }
+        if (i > 0 && metered) { // the relay's ends stay open for it
+            close(relayfd[i-1][0]);
+            close(pipefd[i-1][1]);
+        } else if (i > 0) { // make sure prev proc pipes are closed
+            close(pipefd[i-1][0]); // close read end prev proc pipe
+            close(pipefd[i-1][1]); // close write end prev proc pipe
+        }
+    }
+
+    meter m;
+    if (metered) {
+        metered = pgid != 0 && meter_start(&m, pipefd, relayfd, pipe_ct, pgid);
+        for (int i = 0; i < pipe_ct; i++) {
+            close(pipefd[i][0]);
+            close(relayfd[i][1]);
+        }
+    }
+
+    if (pl->background) {
+        if (pgid != 0) { // at least one stage is running
+            job *j = job_add(pl, pgid, pids, stage_status, stage_usage,
+                cmd_ct);
+            if (isatty(STDIN_FILENO)) {
+                printf("[%d] %d\n", j->id, pgid);
             }
-            /* wait for children to terminate */
-            while(wait3(&status, 0, NULL) <= 0) {}
         }
+        return 0;
+    }
+
+    /* hand the terminal to the pipeline while it runs */
+    if (fg_tty && pgid != 0) {
+        tcsetpgrp(STDIN_FILENO, pgid);
+    }
+
+    int status = wait_foreground(pl, pgid, pids, cmd_ct);
+
+    if (fg_tty) {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    }
+    if (metered) {
+        meter_finish(&m, pl, status != 128 + SIGTSTP);
     }
 
-    return;
+    return status;
 }
 
 /**
- * Takes a single command and parses it to find any redirects, then
- * executes the command
+ * launches a single stage in the shell's own process group with in_fd
+ * and out_fd as its stdin and stdout, unless it redirects them itself.
+ * Returns the pid, or -1 with status set to why it didn't start (0 for
+ * a stage that is only redirects). The caller reaps it
  */
-static void parse_cmd (ListHandler cmd_list)
+pid_t launch_stage (const stage *st, int in_fd, int out_fd, int *status)
 {
-    /* allocate strings for each token plus room for a NULL */
-    char *cmd[cmd_list.count +1];
-
-    tok_node *curr = cmd_list.head;
-    int i = 0;
-    /* build command. stop at first redirect or end */
-    while ((curr != NULL)  && !(curr->special)) {
-        cmd[i++] = curr->token;
-        curr = curr->next;
-    }
-    cmd[i] = NULL; // end of cmd must be NULL for exec
-
-    curr = cmd_list.head;
-    /* stop when curr is whatever is right after the tail of the command */
-    while (curr != ((tok_node *)cmd_list.tail)->next) {
-        if (curr->special) {
-            if (!strcmp(curr->token, ">")) {
-                /* next token should be output file, append false */
-                output_to_file(curr->next->token, false);
-            }
-            if (!strcmp(curr->token, ">>")) {
-                /* next token should be output file, append true */
-                output_to_file(curr->next->token, true);
-            }
-            if (!strcmp(curr->token, "<")) {
-                /* next token should be input to current cmd */
-                file_to_input(curr->next->token);
-            }
-        }
-        curr = curr->next;
+    return start_stage(st, in_fd, out_fd, -1, false, use_spawn(false), status);
+}
+
+/**
+ * continues a stopped or background job. In the foreground it gets the
+ * terminal and is waited on like execute would, returning its exit
+ * status. In the background it is only sent SIGCONT and 0 is returned
+ */
+int resume_job (job *j, bool foreground)
+{
+    if (!foreground) {
+        j->stopped = false;
+        printf("[%d]+ %s &\n", j->id, j->cmd);
+        kill(-j->pgid, SIGCONT);
+        return 0;
     }
 
-    /* run commands locally if they start with ./ or / */
-    if (cmd[0][0] == '/') {
-        cmd[0] = cmd[0] + 1;
-        execv(cmd[0], cmd);
-    } else if (cmd[0][0] == '.') {
-        if (cmd[0][1] == '/') {
-            execv(cmd[0], cmd);
-        }
-    /* if the cmd is a bin in the path, execute */
-    } else if (bin_exists(cmd[0])) {
-        execvp(cmd[0], cmd);
+    printf("%s\n", j->cmd);
+    fflush(stdout);
+    bool fg_tty = owns_terminal();
+    if (fg_tty) {
+        tcsetpgrp(STDIN_FILENO, j->pgid);
+    }
+    j->stopped = false;
+    kill(-j->pgid, SIGCONT);
+
+    int status = 0;
+    if (wait_stages(j->pids, j->status, j->usage, j->count, true)) {
+        j->stopped = true;
+        printf("\n[%d]+  Stopped\t\t%s\n", j->id, j->cmd);
+        status = 128 + SIGTSTP;
     } else {
-        fprintf(stderr, "command %s not found or does not exist\n", cmd[0]);
-        exit(127);
+        status = j->status[j->count - 1];
+        job_remove(j);
+    }
+
+    if (fg_tty) {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
     }
-    perror("could not exec in parse_cmd");
-    exit(-1);
+    return status;
 }
 
 /**
- * Gets the next cmd subsection of the linked list based on whether
- * it reaches the end or it finds a |
+ * gets the exit status of every stage of the last pipeline run by
+ * execute and returns how many stages there were. first gets the index
+ * in that pipeline of the first of them, as a leading cat file isn't run
  */
-static ListHandler get_next_subsection (tok_node *curr)
+int last_pipe_status (const int **statuses, int *first)
 {
-    ListHandler cmd;
-    cmd.head = curr; // head assumed to be first node passed in
-
-    int count = 0;
-    tok_node *prev = NULL;
-    while (curr != NULL) {
-        if (curr->special) {
-            if (!strcmp(curr->token, "|")) { // if pipe found
-                cmd.tail = prev; // then prev token is the tail
-                break;
-            }
-        }
-        prev = curr;
-        curr = curr->next;
-        if (curr == NULL) { // if end was found
-            cmd.tail = prev; // the prev token is the tail
-        }
-        count++;
-    }
-    cmd.count = count;
-
-    return cmd;
+    *statuses = stage_status;
+    *first = stage_first;
+    return stage_ct;
 }
 
 /**
- * checks the path environment variable to see if bin is in it
+ * gets the resources used by every stage of the last pipeline run by
+ * execute and returns how many stages there were. first gets the index
+ * in that pipeline of the first of them, as a leading cat file isn't run
  */
-static bool bin_exists (char *bin)
+int last_pipe_usage (const cmd_usage **usage, int *first)
 {
-    /* get path in form of linked list */
-    path_node *phead = get_path();
+    *usage = stage_usage;
+    *first = stage_first;
+    return stage_ct;
+}
 
-    bool found = false;
-    DIR *dir;
-    struct dirent *entry;
-    path_node *list = phead;
-
-    /* search path to see if the given string bin is in the directories */
-    while (list != NULL && found == false) {
-        if ((dir = opendir(list->path)) != NULL) {
-            while ((entry = readdir(dir)) != NULL && found == false) {
-                if (!strcmp(entry->d_name, bin)) { // if true, the bin exists
-                    found = true;
-                }
-            }
+/**
+ * waits for a foreground pipeline, reaping only our own children in
+ * pipeline order, and adds it to the session's accounting. If it gets
+ * stopped (^Z) the rest of it becomes a job and 128+SIGTSTP is returned
+ */
+static int wait_foreground (const pipeline *pl, pid_t pgid, pid_t *pids,
+    int cmd_ct)
+{
+    uint64_t t = trace_start();
+    bool stopped = wait_stages(pids, stage_status, stage_usage, cmd_ct, true);
+    trace_stop(PH_WAIT, t);
+    if (!stopped) {
+        cmd_usage total = {0};
+        for (int i = 0; i < cmd_ct; i++) {
+            acct_add(&total, &stage_usage[i]);
         }
-        list = list->next;
+        acct_record_pipeline(&total, pl);
+        return stage_status[cmd_ct - 1];
     }
-    closedir(dir);
-    free_path(phead);
-    return found;
+    job *j = job_add(pl, pgid, pids, stage_status, stage_usage, cmd_ct);
+    j->stopped = true;
+    printf("\n[%d]+  Stopped\t\t%s\n", j->id, j->cmd);
+    return 128 + SIGTSTP;
 }
 
 /**
- * count total pipes in a given tok_node linked list
+ * looks a stage up, opens its redirects and launches it into process
+ * group pgid (a new one if 0, the shell's if below 0). Redirects win
+ * over the in_fd and out_fd it is given. Returns the pid, or -1 with
+ * status set if nothing was launched
  */
-static int count_pipes (tok_node *head)
+static pid_t start_stage (const stage *st, int in_fd, int out_fd, pid_t pgid,
+    bool fg_tty, bool spawn, int *status)
 {
-    int pipe_ct = 0;
-    while (head != NULL) {
-        if (head->special) {
-            if (!strcmp(head->token, "|")) {
-                pipe_ct++;
-            }
+    pid_t pid = -1;
+    int rin = -1, rout = -1;
+    int keep = -1; // args kept in every batch, if argv is too big
+
+    /* look the cmd up in the parent so the path cache outlives it */
+    uint64_t t = trace_start();
+    bool builtin = st->argc > 0 && strchr(st->argv[0], '/') == NULL &&
+        is_internal_cmd(st->argv[0]);
+    const char *bin = builtin ? NULL : resolve_cmd(st);
+    trace_stop(PH_LOOKUP, t);
+    if (!open_redirects(st, &rin, &rout)) {
+        *status = 1;
+    } else if (st->argc == 0) {
+        *status = 0; // only redirects, files are made
+    } else if (bin == NULL && !builtin) {
+        fprintf(stderr, "command %s not found or does not exist\n",
+            st->argv[0]);
+        *status = 127;
+    } else if (!builtin && !batch_fits(st->argv) &&
+        (keep = batch_keep(st)) < 0) {
+        fprintf(stderr, "%s: argument list too long\n", st->argv[0]);
+        *status = 126;
+    } else {
+        /* redirects win over pipes */
+        in_fd = (rin >= 0) ? rin : in_fd;
+        out_fd = (rout >= 0) ? rout : out_fd;
+        fflush(NULL); // flush all open output streams(especially pipes)
+        procsub_inherit(st->argv, true);
+        t = trace_start();
+        if (builtin) {
+            trace_count(CNT_FORKS);
+            pid = launch_builtin(st, in_fd, out_fd, pgid, fg_tty);
+        } else if (keep >= 0) {
+            trace_count(CNT_FORKS);
+            pid = launch_batches(st, bin, keep, in_fd, out_fd, pgid, fg_tty);
+        } else if (spawn) {
+            trace_count(CNT_SPAWNS);
+            pid = launch_spawn(st, bin, in_fd, out_fd, pgid, fg_tty);
+        } else {
+            trace_count(CNT_FORKS);
+            pid = launch_fork(st, bin, in_fd, out_fd, pgid, fg_tty);
         }
-        head = head->next;
+        trace_stop(PH_SPAWN, t);
+        procsub_inherit(st->argv, false);
+        if (pid < 0) {
+            *status = 126;
+        }
+    }
+    if (rin >= 0) {
+        close(rin);
     }
-    return pipe_ct;
+    if (rout >= 0) {
+        close(rout);
+    }
+    return pid;
 }
 
 /**
- * gets a file descriptor for the given file name f
+ * finds the file to exec for a cmd. Paths containing a / are run as
+ * given, anything else is looked up in the $PATH cache
+ */
+static const char* resolve_cmd (const stage *st)
+{
+    if (st->argc == 0) {
+        return NULL;
+    }
+    char *name = st->argv[0];
+    if (strchr(name, '/') != NULL) {
+        return name;
+    }
+    return path_lookup(name);
+}
+
+/**
+ * gets a close-on-exec file descriptor for the given file name f,
+ * -1 if it can't be opened
  */
 static int get_fd (char *f, enum Read_Write rw, bool append)
 {
-    int fd;
+    if (rw == HERE_DOC || rw == HERE_STRING) {
+        return here_fd(f, rw == HERE_STRING);
+    }
+    int fd = -1;
     if (rw == READ) {
         /* open f READ only */
-        fd = open(f, O_RDONLY, S_IRUSR | S_IRGRP | S_IROTH);
+        fd = open(f, O_RDONLY | O_CLOEXEC, S_IRUSR | S_IRGRP | S_IROTH);
     }
     if (rw == WRITE) {
         if (append) {
             /* open f WRITE only with append turned on */
-            fd = open(f, O_WRONLY | O_CREAT | O_APPEND, S_IWUSR | S_IRUSR);
+            fd = open(f, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                S_IWUSR | S_IRUSR);
         } else {
-            /* open f WRITE only without append turned on */
-            fd = open(f, O_WRONLY | O_CREAT, S_IWUSR | S_IRUSR);
+            /* open f WRITE only, overwriting what was there */
+            fd = open(f, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                S_IWUSR | S_IRUSR);
         }
     }
     if (fd < 0) {
-        perror("open failed in get_fd\n");
-        exit(-1);
+        perror(f);
     }
 
     return fd;
 }
 
 /**
- * redirect stdout to the file listed after >
- * append controls whether the file is appended or overwritten
+ * returns an fd to read text from, and a \n after it with add_nl. Text
+ * that fits in a pipe is written into one, anything bigger into a
+ * sealed memfd, so neither ever touches the filesystem or needs to be
+ * cleaned up. Returns -1 if neither could be made
  */
-static void output_to_file (char *fname, bool append)
+static int here_fd (const char *text, bool add_nl)
 {
-    int fd;
-    fd = get_fd(fname, WRITE, append);
-    dup2(fd, STDOUT_FILENO); // stdout > file
-    close(fd); // done, connection made with dup2
+    size_t len = strlen(text);
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        perror("pipe failed for here document");
+        return -1;
+    }
+    /* nothing reads the pipe yet, so only what fits can go in */
+    if (len + add_nl <= (size_t)fcntl(fds[1], F_GETPIPE_SZ)) {
+        bool wrote = write_all(fds[1], text, len) &&
+            (!add_nl || write_all(fds[1], "\n", 1));
+        close(fds[1]);
+        if (!wrote) {
+            close(fds[0]);
+            return -1;
+        }
+        return fds[0];
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    int fd = memfd_create("here-document", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        perror("memfd_create failed for here document");
+        return -1;
+    }
+    if (!write_all(fd, text, len) || (add_nl && !write_all(fd, "\n", 1))) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE |
+        F_SEAL_SEAL);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
 }
 
 /**
- * redirect a file to stdin
+ * writes all len bytes of buf to fd. Returns false on an error
  */
-static void file_to_input (char *fname)
+static bool write_all (int fd, const char *buf, size_t len)
 {
-    int fd;
-    fd = get_fd(fname, READ, false);
-    dup2(fd, STDIN_FILENO); // stdin < file
-    close(fd); // done, connection made with dup2
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0) {
+            perror("write failed for here document");
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
 }
 
 /**
- * gets the user's path environment variable and returns it
- * as a linked list
+ * opens every redirect of a stage in the parent. The last input (<,
+ * << or <<<) and the last > or >> win, like they would with repeated
+ * dup2s. Returns false if a file couldn't be opened
  */
-static path_node* get_path()
+bool open_redirects (const stage *st, int *in_fd, int *out_fd)
 {
-    char *fpath = getenv("PATH"); // get path
-    int length = strlen(fpath);
-    char path[length]; // make buffer to store individual path strings
-    path_node *phead = NULL;
-
-    /* go through full path(fpath) searching for colons, which are the
-     * delimiters of the path environment variable */
-    for (int i = 0, j = 0; i < length; i++) {
-        if (fpath[i] == ':') {
-            path[j] = '\0';
-            save_path(path, &phead);
-            j = 0;
-        } else {
-            path[j++] = fpath[i];
+    for (int i = 0; i < st->redir_ct; i++) {
+        const redirect *r = &st->redirs[i];
+        int fd = get_fd(r->file, r->rw, r->append);
+        if (fd < 0) {
+            return false;
+        }
+        int *slot = (r->rw == WRITE) ? out_fd : in_fd;
+        if (*slot >= 0) {
+            close(*slot);
         }
+        *slot = fd;
     }
+    return true;
+}
+
+/**
+ * posix_spawn is used unless MYCLI_LAUNCH=fork. It can only hand the
+ * terminal to a new process group if libc supports it, so fall back
+ * to fork for interactive shells without that
+ */
+static bool use_spawn (bool fg_tty)
+{
+    const char *mode = var_get("MYCLI_LAUNCH");
+    if (mode != NULL && !strcmp(mode, "fork")) {
+        return false;
+    }
+#ifndef POSIX_SPAWN_TCSETPGROUP
+    if (fg_tty) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * launches a stage with posix_spawn. The pipe and redirect wiring is
+ * done with spawn file actions, so the shell's memory is never copied.
+ * Returns the pid, or -1 if it couldn't be launched
+ */
+static pid_t launch_spawn (const stage *st, const char *bin, int in_fd,
+    int out_fd, pid_t pgid, bool fg_tty)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    /* dup2 clears close-on-exec on the new fd */
+    if (in_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    }
+    if (out_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    }
+
+    /* the shell ignores these, the child shouldn't */
+    sigset_t sigdef;
+    sigemptyset(&sigdef);
+    sigaddset(&sigdef, SIGINT);
+    sigaddset(&sigdef, SIGTTOU);
+    sigaddset(&sigdef, SIGTSTP);
+    sigaddset(&sigdef, SIGTTIN);
+    posix_spawnattr_setsigdefault(&attr, &sigdef);
+    /* and it blocks SIGCHLD for the job table's signalfd */
+    posix_spawnattr_setsigmask(&attr, jobs_child_mask());
+
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (pgid >= 0) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, pgid);
+    }
+#ifdef POSIX_SPAWN_TCSETPGROUP
+    /* first stage takes the terminal before it can read from it */
+    if (fg_tty && pgid == 0) {
+        flags |= POSIX_SPAWN_TCSETPGROUP;
+        posix_spawnattr_tcsetpgrp_np(&attr, STDIN_FILENO);
+    }
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    int err = posix_spawn(&pid, bin, &actions, &attr, st->argv,
+        var_envp());
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "could not exec %s: %s\n", st->argv[0], strerror(err));
+        return -1;
+    }
+    return pid;
+}
 
-    return phead;
+/**
+ * launches a stage with fork and execve. Same wiring as launch_spawn,
+ * done by hand in the child
+ */
+static pid_t launch_fork (const stage *st, const char *bin, int in_fd,
+    int out_fd, pid_t pgid, bool fg_tty)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed in execute");
+        return -1;
+    } else if (pid == 0) { // child
+        setup_child(in_fd, out_fd, pgid, fg_tty);
+        execve(bin, st->argv, var_envp());
+        fprintf(stderr, "could not exec %s: %s\n", st->argv[0], strerror(errno));
+        exit(126);
+    }
+    return pid;
 }
 
 /**
- * saves a path into a path_node linked list
+ * runs a builtin stage in a forked copy of the shell, so it can be piped
+ * to and from like any other command. Only stages of pipelines get here,
+ * a builtin on its own runs in the shell
  */
-static void save_path(char *path, path_node **phead)
+static pid_t launch_builtin (const stage *st, int in_fd, int out_fd,
+    pid_t pgid, bool fg_tty)
 {
-    path_node *list = *phead;
-    path_node *p_node = malloc(sizeof(path_node)); // make new node
-    if (p_node == NULL) {
-        perror("malloc failed in save_path()");
-    }
-    int length = strlen(path);
-    p_node->path = malloc(sizeof(char)*length+1); // make space for path
-    if (p_node->path == NULL) {
-        perror("malloc failed in save_path()");
-    }
-    strncpy(p_node->path, path, length+1); // put path in node
-    p_node->path[length] = '\0'; // in case strncpy doesn't null terminate
-    p_node->next = NULL; // set next to NULL, node is going at the end
-
-    if (*phead == NULL) { // if phead is NULL, new node is phead
-        *phead = p_node;
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed in execute");
+        return -1;
+    } else if (pid == 0) { // child
+        setup_child(in_fd, out_fd, pgid, fg_tty);
+        close_exec_fds();
+        /* the signalfd kept for builtins that wait on children of their
+         * own only hears of them while SIGCHLD is blocked, as in the
+         * shell. What they start gets the usual mask */
+        sigset_t chld;
+        sigemptyset(&chld);
+        sigaddset(&chld, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chld, NULL);
+        exit(run_builtin_argv(st->argv, st->argc));
+    }
+    return pid;
+}
+
+/**
+ * runs a stage whose argv is too big for one exec in a forked copy of
+ * the shell, which execs it in batches and exits with the highest exit
+ * status of them. To the rest of the pipeline it is one process
+ */
+static pid_t launch_batches (const stage *st, const char *bin, int keep,
+    int in_fd, int out_fd, pid_t pgid, bool fg_tty)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed in execute");
+        return -1;
+    } else if (pid == 0) { // child
+        setup_child(in_fd, out_fd, pgid, fg_tty);
+        close_exec_fds();
+        exit(batch_run(st, bin, keep));
+    }
+    return pid;
+}
+
+/**
+ * puts a forked child in its process group, gives it back the signals
+ * the shell ignores or blocks, and connects the pipe or redirect to its
+ * STDIN/STDOUT
+ */
+static void setup_child (int in_fd, int out_fd, pid_t pgid, bool fg_tty)
+{
+    if (pgid >= 0) {
+        setpgid(0, pgid);
+    }
+    if (fg_tty) {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL);
+    sigprocmask(SIG_SETMASK, jobs_child_mask(), NULL);
+    if (in_fd >= 0 && dup2(in_fd, STDIN_FILENO) < 0) {
+        perror("dup2 failed in execute");
+    }
+    if (out_fd >= 0 && dup2(out_fd, STDOUT_FILENO) < 0) {
+        perror("dup2 failed in execute");
+    }
+}
+
+/**
+ * closes the close-on-exec fds a forked builtin has no exec to close for
+ * it. Pipe ends of later stages are among them, and holding those open
+ * would keep their readers from ever seeing EOF. The job table's
+ * signalfd stays for builtins that wait on children of their own
+ */
+static void close_exec_fds ()
+{
+    DIR *dp = opendir("/proc/self/fd");
+    if (dp == NULL) {
         return;
-    } else { // otherwise insert node at the end
-        while (list->next != NULL) {
-            list = list->next;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        int fd = atoi(entry->d_name);
+        if (fd > STDERR_FILENO && fd != dirfd(dp) && fd != jobs_fd() &&
+            (fcntl(fd, F_GETFD) & FD_CLOEXEC)) {
+            close(fd);
         }
-        list->next = p_node;
     }
-    return;
+    closedir(dp);
 }
 
 /**
- * takes a path linked list and frees it
+ * reads a pipe size: bytes with an optional k or m, or max for the
+ * most /proc/sys/fs/pipe-max-size allows. Returns -1 if it isn't one
  */
-static void free_path (path_node *phead)
+long parse_pipe_size (const char *arg)
 {
-    path_node *list = phead;
-    while (list != NULL) {
-        phead = phead->next;
-        free(list->path);
-        free(list);
-        list = phead;
+    if (!strcmp(arg, "max")) {
+        return pipe_max_size();
     }
+    char *end;
+    long size = strtol(arg, &end, 10);
+    if (*end == 'k' || *end == 'K') {
+        size *= 1024;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        size *= 1024 * 1024;
+        end++;
+    }
+    if (end == arg || *end != '\0' || size <= 0) {
+        return -1;
+    }
+    return size;
+}
+
+/**
+ * creates a close-on-exec pipe holding size bytes, or the kernel's
+ * default if size is 0 or can't be had
+ */
+static void make_pipe (int *fds, long size)
+{
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        perror("pipe failed in execute");
+        return;
+    }
+    if (size > 0) {
+        fcntl(fds[1], F_SETPIPE_SZ, (int)size);
+    }
+}
+
+/**
+ * the pipe size for a pipeline, its own or $MYCLI_PIPE_SIZE, raised up
+ * to at most pipe-max-size. 0 leaves the kernel's default
+ */
+static long pipe_capacity (const pipeline *pl)
+{
+    long size = pl->pipe_size;
+    const char *env = var_get("MYCLI_PIPE_SIZE");
+    if (size == 0 && env != NULL) {
+        size = parse_pipe_size(env);
+    }
+    if (size <= 0) {
+        return 0;
+    }
+    long max = pipe_max_size();
+    return (max > 0 && size > max) ? max : size;
+}
+
+/**
+ * the biggest pipe an unprivileged process may ask for, read once from
+ * /proc/sys/fs/pipe-max-size. 0 if it can't be read
+ */
+static long pipe_max_size ()
+{
+    static long max = -1;
+    if (max < 0) {
+        max = 0;
+        FILE *f = fopen("/proc/sys/fs/pipe-max-size", "r");
+        if (f != NULL) {
+            if (fscanf(f, "%ld", &max) != 1) {
+                max = 0;
+            }
+            fclose(f);
+        }
+    }
+    return max;
+}
+
+/**
+ * true if a stage is cat of one readable regular file and nothing else,
+ * so whatever reads its output could read the file instead
+ */
+static bool is_plain_cat (const stage *st)
+{
+    struct stat sb;
+    return st->argc == 2 && st->redir_ct == 0 && !strcmp(st->argv[0], "cat") &&
+        st->argv[1][0] != '-' && stat(st->argv[1], &sb) == 0 &&
+        S_ISREG(sb.st_mode) && access(st->argv[1], R_OK) == 0;
+}
+
+/**
+ * true if the shell is interactive and in the foreground, so it can
+ * give the terminal to the commands it runs
+ */
+static bool owns_terminal ()
+{
+    return isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
 }
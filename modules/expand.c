@@ -0,0 +1,326 @@
+/************************************************
+ *                  expand.c                    *
+ ************************************************
+ * expand turns the tokens of a line into the   *
+ * words that are run, doing the substitutions  *
+ * the tokenizer marked: <(cmd) and >(cmd)      *
+ * become /dev/fd paths, $(cmd) becomes the     *
+ * output of cmd and $NAME its value, split     *
+ * into fields at $IFS unless it was quoted,    *
+ * and words with patterns become the paths     *
+ * they match                                   *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/expand.h"
+#include "../includes/pipeline.h"
+#include "../includes/procsub.h"
+#include "../includes/cmdsub.h"
+#include "../includes/vars.h"
+#include "../includes/wildcard.h"
+#include <stdio.h>
+#include <string.h>
+
+/* a word being put together from text and substitutions */
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    bool started; // a quoted empty substitution still makes a word
+    bool glob; // has a MARK_GLOB pattern char in it
+    bool escaped; // has a MARK_GLOB doubled, from substituted text
+} word_buf;
+
+static void expand_word (const char *, ListHandler *, bool);
+static void split_in_place (char *, size_t, ListHandler *);
+static const char *substitute (const char *, const char **, size_t *,
+    bool *);
+static void set_ifs ();
+static void append (word_buf *, const char *, size_t, arena *);
+static void append_text (word_buf *, const char *, size_t, arena *, bool);
+static void end_word (word_buf *, ListHandler *);
+static void add_word (ListHandler *, char *, bool);
+static void strip_globs (char *);
+static bool is_ifs (char);
+
+/* chars of $IFS, set for each line */
+static bool ifs_table[256];
+
+/**
+ * appends the words every token of in expands to onto out, whose arena
+ * holds them. Tokens without substitutions are added as they are. The
+ * NAME=value words a line starts with are never split. Returns false
+ * if a process substitution couldn't be started
+ */
+bool expand_tokens (ListHandler in, ListHandler *out)
+{
+    set_ifs();
+    bool assigning = true;
+    for (int i = 0; i < in.count; i++) {
+        tok_node *t = &in.head[i];
+        assigning = assigning && !t->special && var_assign_len(t->token) > 0;
+        if (is_proc_subst(t)) {
+            int fd = procsub_open(t->token + 2, strlen(t->token) - 3,
+                t->token[0] == '>');
+            if (fd < 0) {
+                return false;
+            }
+            char *path = arena_alloc(out->mem, sizeof("/dev/fd/") + 11);
+            sprintf(path, "/dev/fd/%d", fd);
+            add_word(out, path, false);
+        } else if (!t->special && strpbrk(t->token, MARKS) != NULL) {
+            expand_word(t->token, out, !assigning);
+        } else {
+            add_word(out, t->token, t->special);
+        }
+    }
+    return true;
+}
+
+/**
+ * expands one token, into fields if split. A token that is only an
+ * unquoted $(cmd), the usual case, is split where its output sits.
+ * Anything else is put together in out's arena
+ */
+static void expand_word (const char *tok, ListHandler *out, bool split)
+{
+    const char *rest;
+    size_t len;
+    bool quoted;
+    if (split && tok[0] == MARK_CMD && tok[1] == 'u' &&
+        strchr(tok + 2, MARK_CMD)[1] == '\0') {
+        char *text = (char *)substitute(tok, &rest, &len, &quoted);
+        split_in_place(text, len, out);
+        return;
+    }
+
+    word_buf wb = {NULL, 0, 0, false, false, false};
+    while (*tok != '\0') {
+        if (*tok == MARK_GLOB) { // kept marked for end_word, unless split
+            append(&wb, tok + !split, 1 + split, out->mem);
+            wb.glob = wb.glob || split;
+            tok += 2;
+            continue;
+        }
+        if (*tok != MARK_CMD && *tok != MARK_VAR) {
+            const char *mark = strpbrk(tok, MARKS);
+            size_t n = mark ? (size_t)(mark - tok) : strlen(tok);
+            append(&wb, tok, n, out->mem);
+            tok += n;
+            continue;
+        }
+        const char *text = substitute(tok, &tok, &len, &quoted);
+        if (quoted || !split) {
+            append_text(&wb, text, len, out->mem, split);
+            continue;
+        }
+        /* fields join the text on either side of them */
+        size_t i = 0;
+        while (i < len) {
+            if (is_ifs(text[i])) {
+                while (i < len && is_ifs(text[i])) {
+                    i++;
+                }
+                end_word(&wb, out);
+                continue;
+            }
+            size_t start = i;
+            while (i < len && !is_ifs(text[i])) {
+                i++;
+            }
+            append_text(&wb, text + start, i - start, out->mem, true);
+        }
+    }
+    end_word(&wb, out);
+}
+
+/**
+ * adds each field of text as a word, ending them with \0s written over
+ * the whitespace after them, so nothing is copied
+ */
+static void split_in_place (char *text, size_t len, ListHandler *out)
+{
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && is_ifs(text[i])) {
+            i++;
+        }
+        if (i == len) {
+            break;
+        }
+        size_t start = i;
+        while (i < len && !is_ifs(text[i])) {
+            i++;
+        }
+        text[i] = '\0'; // the output always has a byte spare after it
+        add_word(out, text + start, false);
+        i++;
+    }
+}
+
+/**
+ * does the substitution marked at s and returns what it becomes,
+ * setting len to its length, quoted to whether it was in double quotes
+ * and rest to just past it. $(cmd) gives cmd's output without trailing
+ * newlines, which may be written to. $NAME gives the value itself,
+ * which may not
+ */
+static const char *substitute (const char *s, const char **rest,
+    size_t *len, bool *quoted)
+{
+    const char *body = s + 2;
+    const char *end = strchr(body, s[0]);
+    *quoted = (s[1] == 'q');
+    *rest = end + 1;
+    if (s[0] == MARK_VAR) {
+        const char *value = var_getn(body, end - body);
+        *len = value ? strlen(value) : 0;
+        return value;
+    }
+    char *text = cmdsub_capture(body, end - body, len);
+    while (*len > 0 && text[*len - 1] == '\n') {
+        (*len)--;
+    }
+    return text;
+}
+
+/**
+ * adds n chars to the word being put together, growing it in mem
+ */
+static void append (word_buf *wb, const char *s, size_t n, arena *mem)
+{
+    wb->started = true;
+    if (wb->len + n >= wb->cap) {
+        size_t cap = 2 * (wb->len + n) + 64;
+        char *buf = arena_alloc(mem, cap);
+        if (wb->len) {
+            memcpy(buf, wb->buf, wb->len);
+        }
+        wb->buf = buf;
+        wb->cap = cap;
+    }
+    if (n > 0) {
+        memcpy(wb->buf + wb->len, s, n);
+    }
+    wb->len += n;
+}
+
+/**
+ * appends substituted text to the word being put together. If the word
+ * may be a pattern, a MARK_GLOB in the text is doubled so it is only
+ * ever a literal char, never a pattern char
+ */
+static void append_text (word_buf *wb, const char *s, size_t n, arena *mem,
+    bool pattern)
+{
+    const char *mark;
+    while (pattern && n > 0 && (mark = memchr(s, MARK_GLOB, n)) != NULL) {
+        size_t k = mark - s + 1;
+        append(wb, s, k, mem);
+        append(wb, mark, 1, mem);
+        wb->escaped = true;
+        s += k;
+        n -= k;
+    }
+    append(wb, s, n, mem);
+}
+
+/**
+ * adds the word being put together to out, if one was started, and
+ * starts the next one after it. A pattern adds the paths it matches
+ * instead, or itself if it matches none
+ */
+static void end_word (word_buf *wb, ListHandler *out)
+{
+    if (!wb->started) {
+        return;
+    }
+    if (wb->cap == 0) { // only empty quoted output, nothing allocated
+        append(wb, "", 0, out->mem);
+    }
+    wb->buf[wb->len] = '\0';
+    if (wb->glob) {
+        wb->glob = false;
+        char **matches;
+        int n = wildcard_expand(wb->buf, out->mem, &matches);
+        if (n > 0) {
+            for (int i = 0; i < n; i++) {
+                add_word(out, matches[i], false);
+            }
+            wb->len = 0; // the pattern's space is used for the next word
+            wb->started = false;
+            return;
+        }
+        strip_globs(wb->buf);
+    } else if (wb->escaped) {
+        strip_globs(wb->buf);
+    }
+    wb->escaped = false;
+    add_word(out, wb->buf, false);
+    wb->buf += wb->len + 1;
+    wb->cap -= wb->len + 1;
+    wb->len = 0;
+    wb->started = false;
+}
+
+/**
+ * appends a word to out, growing its array inside its arena
+ */
+static void add_word (ListHandler *out, char *word, bool special)
+{
+    if (out->count == out->cap) {
+        int cap = out->cap ? out->cap * 2 : 16;
+        tok_node *toks = arena_alloc(out->mem, sizeof(tok_node) * cap);
+        if (out->count) {
+            memcpy(toks, out->head, sizeof(tok_node) * out->count);
+        }
+        out->head = toks;
+        out->cap = cap;
+    }
+    out->head[out->count].token = word;
+    out->head[out->count].special = special;
+    out->count++;
+}
+
+/**
+ * takes the MARK_GLOBs out of a word, for a pattern that matched nothing,
+ * leaving the char each one was before, which is a literal MARK_GLOB if
+ * it was doubled
+ */
+static void strip_globs (char *word)
+{
+    char *to = word;
+    for (char *from = word; *from; from++) {
+        if (*from == MARK_GLOB && from[1] != '\0') {
+            from++;
+        }
+        *to++ = *from;
+    }
+    *to = '\0';
+}
+
+/**
+ * reads $IFS into ifs_table. Unset is space, tab and newline. Every IFS
+ * char is treated like whitespace, runs of them are one separator
+ */
+static void set_ifs ()
+{
+    const char *ifs = var_get("IFS");
+    if (ifs == NULL) {
+        ifs = " \t\n";
+    }
+    memset(ifs_table, 0, sizeof(ifs_table));
+    for (; *ifs; ifs++) {
+        ifs_table[(unsigned char)*ifs] = true;
+    }
+}
+
+/**
+ * true if c separates the fields of unquoted output
+ */
+static bool is_ifs (char c)
+{
+    return ifs_table[(unsigned char)c];
+}
@@ -0,0 +1,278 @@
+/************************************************
+ *                   fanout.c                   *
+ ************************************************
+ * fanout gives a copy of its stdin to several  *
+ * commands at once. The data is duplicated     *
+ * with tee and moved with splice, so it never  *
+ * passes through the shell's memory, and it    *
+ * goes only as fast as the slowest command     *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#define _GNU_SOURCE
+
+#include "../includes/fanout.h"
+#include "../includes/executor.h"
+#include "../includes/jobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+
+typedef struct {
+    int out_fd; // write end of the command's stdin, -1 once it's gone
+    int held[2]; // this round's data, waiting to go to out_fd
+    size_t left; // bytes still in held
+} consumer;
+
+static ssize_t fill (int, int, size_t, char **);
+static bool duplicate (consumer *, int, int, size_t);
+static int drain (consumer *, int);
+static void drop (consumer *);
+static long sized_pipe (int *, long);
+
+/**
+ * runs each of count commands with a copy of stdin as their stdin and
+ * waits for them. Data goes round by round: up to one pipe's worth is
+ * moved into a pipe of fanout's own, teed into a pipe held for each
+ * command, and spliced on to them, and the next round only starts once
+ * every command has taken all of it. pipe_size is the bytes per pipe, 0
+ * for the kernel's default. Returns the first nonzero exit status
+ */
+int run_fanout (const stage *cmds, int count, long pipe_size)
+{
+    int src[2]; // this round's data before it's duplicated
+    long cap = sized_pipe(src, pipe_size);
+    if (cap < 0) {
+        return 1;
+    }
+
+    consumer c[count];
+    pid_t pids[count];
+    int status[count];
+    cmd_usage usage[count];
+    int alive = 0;
+    for (int k = 0; k < count; k++) {
+        c[k].out_fd = -1;
+        c[k].left = 0;
+        pids[k] = -1;
+        status[k] = 1;
+        int in[2];
+        /* held must be as big as src so a tee always fits whole */
+        long got = sized_pipe(c[k].held, cap);
+        if (got != cap) {
+            if (got >= 0) {
+                close(c[k].held[0]);
+                close(c[k].held[1]);
+            }
+            fprintf(stderr, "fanout: couldn't get a %ld byte pipe\n", cap);
+            continue;
+        }
+        if (sized_pipe(in, cap) < 0) {
+            close(c[k].held[0]);
+            close(c[k].held[1]);
+            continue;
+        }
+        pids[k] = launch_stage(&cmds[k], in[0], -1, &status[k]);
+        close(in[0]);
+        c[k].out_fd = in[1];
+        if (pids[k] < 0) {
+            drop(&c[k]);
+        } else {
+            alive++;
+        }
+    }
+
+    /* a command that quits only loses its own copy. Set after the
+     * launches, as an ignored signal would stay ignored across exec */
+    void (*old_pipe) (int) = signal(SIGPIPE, SIG_IGN);
+    char *buf = NULL;
+    while (alive > 0) {
+        ssize_t n = fill(STDIN_FILENO, src[1], cap, &buf);
+        if (n <= 0 || !duplicate(c, count, src[0], n)) {
+            break;
+        }
+        alive = drain(c, count);
+    }
+    signal(SIGPIPE, old_pipe);
+    free(buf);
+    close(src[0]);
+    close(src[1]);
+
+    for (int k = 0; k < count; k++) {
+        drop(&c[k]); // EOF for whoever is still reading
+    }
+    wait_stages(pids, status, usage, count, false);
+    for (int k = 0; k < count; k++) {
+        if (status[k] != 0) {
+            return status[k];
+        }
+    }
+    return 0;
+}
+
+/**
+ * moves up to len bytes from fd into the empty pipe at pipe_in, waiting
+ * until there are some. What splice can't read, like a terminal, is
+ * copied through *buf instead. Returns the bytes moved, 0 at EOF or -1
+ */
+static ssize_t fill (int fd, int pipe_in, size_t len, char **buf)
+{
+    while (*buf == NULL) {
+        ssize_t n = splice(fd, NULL, pipe_in, NULL, len, SPLICE_F_MOVE);
+        if (n >= 0) {
+            return n;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EINVAL) {
+            perror("splice failed in fanout");
+            return -1;
+        }
+        *buf = malloc(len);
+        if (*buf == NULL) {
+            perror("malloc failed in fanout");
+            exit(-1);
+        }
+    }
+
+    ssize_t n;
+    while ((n = read(fd, *buf, len)) < 0 && errno == EINTR) {
+        continue;
+    }
+    if (n < 0) {
+        perror("read failed in fanout");
+        return -1;
+    }
+    for (ssize_t done = 0; done < n;) {
+        ssize_t put = write(pipe_in, *buf + done, n - done);
+        if (put < 0 && errno != EINTR) {
+            perror("write failed in fanout");
+            return -1;
+        }
+        done += put > 0 ? put : 0;
+    }
+    return n;
+}
+
+/**
+ * hands the n bytes in src to every command still reading: a tee into
+ * each one's held pipe, except the last, which splices them out of src.
+ * The held pipes are empty and as big as src, so all of src fits
+ */
+static bool duplicate (consumer *c, int count, int src, size_t n)
+{
+    int last = count - 1;
+    while (c[last].out_fd < 0) {
+        last--;
+    }
+    for (int k = 0; k < last; k++) {
+        if (c[k].out_fd < 0) {
+            continue;
+        }
+        ssize_t got;
+        while ((got = tee(src, c[k].held[1], n, 0)) < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got != (ssize_t)n) {
+            fprintf(stderr, "fanout: tee came up short\n");
+            return false;
+        }
+        c[k].left = n;
+    }
+    for (size_t moved = 0; moved < n;) {
+        ssize_t got = splice(src, NULL, c[last].held[1], NULL, n - moved,
+            SPLICE_F_MOVE);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        } else if (got <= 0) {
+            perror("splice failed in fanout");
+            return false;
+        }
+        moved += got;
+    }
+    c[last].left = n;
+    return true;
+}
+
+/**
+ * splices each command's held data into its stdin until none is left,
+ * waiting on whichever stdin is full. That wait is what holds the
+ * producer to the pace of the slowest command. A command that quit is
+ * dropped. Returns how many are still reading
+ */
+static int drain (consumer *c, int count)
+{
+    struct pollfd fds[count];
+    while (true) {
+        int waiting = 0;
+        for (int k = 0; k < count; k++) {
+            fds[k].fd = -1;
+            fds[k].events = POLLOUT;
+            while (c[k].out_fd >= 0 && c[k].left > 0) {
+                ssize_t n = splice(c[k].held[0], NULL, c[k].out_fd, NULL,
+                    c[k].left, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n > 0) {
+                    c[k].left -= n;
+                } else if (n < 0 && errno == EINTR) {
+                    continue;
+                } else if (n < 0 && errno == EAGAIN) {
+                    fds[k].fd = c[k].out_fd;
+                    waiting++;
+                    break;
+                } else {
+                    drop(&c[k]); // EPIPE, it quit
+                }
+            }
+        }
+        if (waiting == 0) {
+            break;
+        }
+        if (poll(fds, count, -1) < 0 && errno != EINTR) {
+            perror("poll failed in fanout");
+            break;
+        }
+    }
+
+    int alive = 0;
+    for (int k = 0; k < count; k++) {
+        alive += c[k].out_fd >= 0;
+    }
+    return alive;
+}
+
+/**
+ * stops feeding a command, closing its stdin and its held pipe
+ */
+static void drop (consumer *c)
+{
+    if (c->out_fd < 0) {
+        return;
+    }
+    close(c->out_fd);
+    close(c->held[0]);
+    close(c->held[1]);
+    c->out_fd = -1;
+    c->left = 0;
+}
+
+/**
+ * creates a close-on-exec pipe of size bytes, or the kernel's default
+ * if size is 0 or can't be had. Returns the size it got, or -1
+ */
+static long sized_pipe (int *fds, long size)
+{
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        perror("pipe failed in fanout");
+        return -1;
+    }
+    if (size > 0) {
+        fcntl(fds[1], F_SETPIPE_SZ, size);
+    }
+    return fcntl(fds[1], F_GETPIPE_SZ);
+}
@@ -0,0 +1,465 @@
+/************************************************
+ *                  history.c                   *
+ ************************************************
+ * history appends every line typed at the      *
+ * prompt to a log file, with when it ran, how  *
+ * long it took, its exit status and the        *
+ * directory it ran in. Each record is one      *
+ * O_APPEND write, so sessions sharing the file *
+ * never split each other's records. The log is *
+ * mmapped and indexed by trigram the first     *
+ * time it is searched, and only the records    *
+ * added since are read after that              *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#define _GNU_SOURCE // mremap, memmem
+#include "../includes/history.h"
+#include "../includes/vars.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HIST_MAGIC 0x7473684dU // "Mhst"
+#define HIST_ALIGN 8 // records start and end on multiples of this
+#define MIN_SLOTS 4096
+
+/* one record of the log. The cwd follows it, then the line without its
+ * \n, then zeros up to size */
+typedef struct {
+    uint32_t magic;
+    uint32_t size; // the whole record, a multiple of HIST_ALIGN
+    int64_t when; // wall clock ns when the line started
+    int64_t took; // ns it ran for
+    int32_t status;
+    uint32_t cwd_len;
+    uint32_t line_len;
+    uint32_t pad;
+} hist_rec;
+
+/* the entries a trigram is in, in order */
+typedef struct {
+    uint32_t key; // the trigram's 3 chars + 1, 0 for an empty slot
+    uint32_t ct;
+    uint32_t cap;
+    uint32_t *ids;
+} posting;
+
+static int hist_fd = -2; // -2 until it is opened, -1 if it can't be
+static char *map = NULL;
+static size_t map_len = 0;
+static size_t indexed = 0; // bytes of the log read into the index
+
+static uint64_t *offsets = NULL; // of each entry's record, oldest first
+static uint32_t entry_ct = 0;
+static uint32_t entry_cap = 0;
+
+static posting *trigrams = NULL; // open addressing by key
+static size_t tri_slots = 0;
+static size_t tri_used = 0;
+
+/* the line being run, recorded once it is done */
+static char *pending = NULL;
+static size_t pending_len = 0;
+static size_t pending_cap = 0;
+static int64_t pending_when;
+static int64_t pending_start;
+
+static int open_log ();
+static bool refresh ();
+static void drop_index ();
+static void add_entry (uint64_t, const hist_rec *);
+static void add_trigram (uint32_t, uint32_t);
+static posting *find_trigram (uint32_t);
+static void grow_trigrams ();
+static bool rarest (const char *, size_t, const posting **);
+static const hist_rec *entry (uint32_t);
+static const char *rec_line (const hist_rec *);
+static void print_entry (uint32_t);
+static int64_t clock_ns (clockid_t);
+
+/**
+ * remembers a line that is about to run, to be recorded with
+ * history_finish. Blank lines aren't recorded
+ */
+void history_start (const char *line, size_t len)
+{
+    while (len > 0 && (line[len-1] == '\n' || line[len-1] == ' ')) {
+        len--;
+    }
+    pending_len = len;
+    if (len == 0) {
+        return;
+    }
+    if (len > pending_cap) {
+        pending_cap = len * 2;
+        if ((pending = realloc(pending, pending_cap)) == NULL) {
+            perror("realloc failed in history_start");
+            exit(-1);
+        }
+    }
+    memcpy(pending, line, len);
+    pending_when = clock_ns(CLOCK_REALTIME);
+    pending_start = clock_ns(CLOCK_MONOTONIC);
+}
+
+/**
+ * appends the line from history_start to the log, with the status it
+ * exited with. The record goes in one write, which O_APPEND puts after
+ * anything other sessions have written
+ */
+void history_finish (int status)
+{
+    if (pending_len == 0 || open_log() < 0) {
+        return;
+    }
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        cwd[0] = '\0';
+    }
+    size_t cwd_len = strlen(cwd);
+    size_t size = sizeof(hist_rec) + cwd_len + pending_len;
+    size = (size + HIST_ALIGN - 1) & ~(size_t)(HIST_ALIGN - 1);
+    char *buf = calloc(1, size);
+    if (buf == NULL) {
+        perror("malloc failed in history_finish");
+        exit(-1);
+    }
+    hist_rec *r = (hist_rec *)buf;
+    r->magic = HIST_MAGIC;
+    r->size = size;
+    r->when = pending_when;
+    r->took = clock_ns(CLOCK_MONOTONIC) - pending_start;
+    r->status = status;
+    r->cwd_len = cwd_len;
+    r->line_len = pending_len;
+    memcpy(buf + sizeof(hist_rec), cwd, cwd_len);
+    memcpy(buf + sizeof(hist_rec) + cwd_len, pending, pending_len);
+    if (write(hist_fd, buf, size) != (ssize_t)size) {
+        perror("history");
+    }
+    free(buf);
+    pending_len = 0;
+}
+
+/**
+ * the newest line that starts with the len chars of prefix, or the
+ * newest line if len is 0. Sets line_len to its length, it has no \n.
+ * It points into the log and is good until the next history call.
+ * NULL if there is none
+ */
+const char *history_recall (const char *prefix, size_t len,
+    size_t *line_len)
+{
+    if (!refresh()) {
+        return NULL;
+    }
+    const posting *p = NULL;
+    if (len >= 3 && !rarest(prefix, len, &p)) {
+        return NULL;
+    }
+    uint32_t ct = p ? p->ct : entry_ct;
+    for (uint32_t i = ct; i-- > 0;) {
+        const hist_rec *r = entry(p ? p->ids[i] : i);
+        if (r->line_len >= len && !memcmp(rec_line(r), prefix, len)) {
+            *line_len = r->line_len;
+            return rec_line(r);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * prints the last n entries, or all of them if n < 0. Returns true if
+ * there is no log
+ */
+bool history_print (long n)
+{
+    if (!refresh()) {
+        fprintf(stderr, "history: no history file\n");
+        return true;
+    }
+    uint32_t first = (n < 0 || n >= entry_ct) ? 0 : entry_ct - n;
+    for (uint32_t id = first; id < entry_ct; id++) {
+        print_entry(id);
+    }
+    return false;
+}
+
+/**
+ * prints every entry with text in its line, oldest first. Only the
+ * entries holding text's rarest trigram are looked at. Returns true if
+ * there is no log
+ */
+bool history_search (const char *text)
+{
+    if (!refresh()) {
+        fprintf(stderr, "history: no history file\n");
+        return true;
+    }
+    size_t len = strlen(text);
+    const posting *p = NULL;
+    if (len >= 3 && !rarest(text, len, &p)) {
+        return false; // some trigram of it was never typed
+    }
+    uint32_t ct = p ? p->ct : entry_ct;
+    for (uint32_t i = 0; i < ct; i++) {
+        uint32_t id = p ? p->ids[i] : i;
+        const hist_rec *r = entry(id);
+        if (memmem(rec_line(r), r->line_len, text, len) != NULL) {
+            print_entry(id);
+        }
+    }
+    return false;
+}
+
+/**
+ * opens the log, $MYCLI_HISTFILE or ~/.mycli_history, the first time
+ * it is needed. Nothing is read from it. Returns the fd, -1 if it
+ * can't be opened
+ */
+static int open_log ()
+{
+    if (hist_fd != -2) {
+        return hist_fd;
+    }
+    hist_fd = -1;
+    const char *file = var_get("MYCLI_HISTFILE");
+    char path[PATH_MAX];
+    if (file == NULL) {
+        const char *home = var_get("HOME");
+        if (home == NULL) {
+            return -1;
+        }
+        snprintf(path, sizeof(path), "%s/.mycli_history", home);
+        file = path;
+    }
+    hist_fd = open(file, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    return hist_fd;
+}
+
+/**
+ * maps any of the log that other sessions or this one added since the
+ * last call and indexes the records in it. A record that isn't all
+ * there yet is left for next time. A log that was truncated is indexed
+ * again from the start. Returns false if there is no log
+ */
+static bool refresh ()
+{
+    struct stat st;
+    if (open_log() < 0 || fstat(hist_fd, &st) < 0) {
+        return false;
+    }
+    size_t size = st.st_size;
+    if (size < map_len || (entry_ct > 0 &&
+        entry(entry_ct - 1)->magic != HIST_MAGIC)) {
+        drop_index(); // cut short or rewritten, the map goes past its end
+    }
+    if (size > map_len) {
+        void *m = (map == NULL) ?
+            mmap(NULL, size, PROT_READ, MAP_SHARED, hist_fd, 0) :
+            mremap(map, map_len, size, MREMAP_MAYMOVE);
+        if (m == MAP_FAILED) {
+            perror("history");
+            return false;
+        }
+        map = m;
+        map_len = size;
+        madvise(map + indexed, map_len - indexed, MADV_SEQUENTIAL);
+    }
+
+    size_t off = indexed;
+    while (off + sizeof(hist_rec) <= map_len) {
+        const hist_rec *r = (const hist_rec *)(map + off);
+        if (r->magic != HIST_MAGIC || r->size % HIST_ALIGN != 0 ||
+            (uint64_t)sizeof(hist_rec) + r->cwd_len + r->line_len > r->size) {
+            off += HIST_ALIGN; // not a record, look for the next one
+            continue;
+        }
+        if (off + r->size > map_len) {
+            break;
+        }
+        add_entry(off, r);
+        off += r->size;
+    }
+    indexed = off;
+    return true;
+}
+
+/**
+ * forgets the map and everything indexed from it, so the log is read
+ * again from the start
+ */
+static void drop_index ()
+{
+    if (map != NULL) {
+        munmap(map, map_len);
+    }
+    map = NULL;
+    map_len = 0;
+    indexed = 0;
+    entry_ct = 0;
+    for (size_t i = 0; i < tri_slots; i++) {
+        free(trigrams[i].ids);
+    }
+    if (tri_slots > 0) {
+        memset(trigrams, 0, sizeof(posting) * tri_slots);
+    }
+    tri_used = 0;
+}
+
+/**
+ * adds the record at off to the entries and its line's trigrams to
+ * the index
+ */
+static void add_entry (uint64_t off, const hist_rec *r)
+{
+    if (entry_ct == entry_cap) {
+        entry_cap = entry_cap ? entry_cap * 2 : 1024;
+        offsets = realloc(offsets, sizeof(uint64_t) * entry_cap);
+        if (offsets == NULL) {
+            perror("realloc failed in add_entry");
+            exit(-1);
+        }
+    }
+    uint32_t id = entry_ct++;
+    offsets[id] = off;
+    const unsigned char *line = (const unsigned char *)rec_line(r);
+    for (uint32_t i = 0; i + 3 <= r->line_len; i++) {
+        add_trigram((line[i] << 16 | line[i+1] << 8 | line[i+2]) + 1, id);
+    }
+}
+
+/**
+ * adds entry id to the list of the trigram key, once
+ */
+static void add_trigram (uint32_t key, uint32_t id)
+{
+    if ((tri_used + 1) * 2 > tri_slots) { // over half full
+        grow_trigrams();
+    }
+    posting *p = find_trigram(key);
+    if (p->key == 0) {
+        p->key = key;
+        tri_used++;
+    } else if (p->ids[p->ct - 1] == id) {
+        return; // already there from earlier in the line
+    }
+    if (p->ct == p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 4;
+        if ((p->ids = realloc(p->ids, sizeof(uint32_t) * p->cap)) == NULL) {
+            perror("realloc failed in add_trigram");
+            exit(-1);
+        }
+    }
+    p->ids[p->ct++] = id;
+}
+
+/**
+ * the slot of a trigram, or the empty slot it would go in
+ */
+static posting *find_trigram (uint32_t key)
+{
+    size_t mask = tri_slots - 1;
+    size_t i = (key * 2654435761U) & mask;
+    while (trigrams[i].key != 0 && trigrams[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return &trigrams[i];
+}
+
+/**
+ * doubles the trigram table, moving every list to its new slot
+ */
+static void grow_trigrams ()
+{
+    posting *old = trigrams;
+    size_t old_slots = tri_slots;
+    tri_slots = tri_slots ? tri_slots * 2 : MIN_SLOTS;
+    trigrams = calloc(tri_slots, sizeof(posting));
+    if (trigrams == NULL) {
+        perror("malloc failed in grow_trigrams");
+        exit(-1);
+    }
+    for (size_t i = 0; i < old_slots; i++) {
+        if (old[i].key != 0) {
+            *find_trigram(old[i].key) = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * finds the trigram of the len >= 3 chars of text that is in the
+ * fewest entries. Returns false if one of them is in none
+ */
+static bool rarest (const char *text, size_t len, const posting **best)
+{
+    if (tri_slots == 0) {
+        return false;
+    }
+    const unsigned char *s = (const unsigned char *)text;
+    *best = NULL;
+    for (size_t i = 0; i + 3 <= len; i++) {
+        const posting *p = find_trigram((s[i] << 16 | s[i+1] << 8 | s[i+2]) + 1);
+        if (p->key == 0) {
+            return false;
+        }
+        if (*best == NULL || p->ct < (*best)->ct) {
+            *best = p;
+        }
+    }
+    return true;
+}
+
+/**
+ * the record of entry id
+ */
+static const hist_rec *entry (uint32_t id)
+{
+    return (const hist_rec *)(map + offsets[id]);
+}
+
+/**
+ * the line of a record, which has no \n or \0 after it
+ */
+static const char *rec_line (const hist_rec *r)
+{
+    return (const char *)(r + 1) + r->cwd_len;
+}
+
+/**
+ * prints an entry's number, when it ran, how long for, its exit status,
+ * where and the line
+ */
+static void print_entry (uint32_t id)
+{
+    const hist_rec *r = entry(id);
+    time_t secs = r->when / 1000000000;
+    struct tm tm;
+    char when[32];
+    localtime_r(&secs, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    printf("%7u  %s  %8.3fs  %3d  %.*s  %.*s\n", id + 1, when,
+        r->took / 1e9, r->status, (int)r->cwd_len, (const char *)(r + 1),
+        (int)r->line_len, rec_line(r));
+}
+
+/**
+ * a clock's time in ns
+ */
+static int64_t clock_ns (clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
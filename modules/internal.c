@@ -9,56 +9,205 @@
 
 #include "../includes/internal.h"
 #include "../includes/mycli.h"
+#include "../includes/pathcache.h"
+#include "../includes/cmdcache.h"
+#include "../includes/executor.h"
+#include "../includes/jobs.h"
+#include "../includes/parallel.h"
+#include "../includes/fanout.h"
+#include "../includes/linereader.h"
+#include "../includes/accounting.h"
+#include "../includes/trace.h"
+#include "../includes/builtins.h"
+#include "../includes/vars.h"
+#include "../includes/batch.h"
+#include "../includes/history.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+
+/* takes the rest of the line itself, pipes and redirects included */
+#define BI_WHOLE_LINE 1
+/* failing is its exit status, not an error to report */
+#define BI_STATUS 2
+/* only prints, so $(cmd) can run it in the shell without a subshell */
+#define BI_PURE 4
+
+typedef struct {
+    const char *name;
+    bool (*run) (ListHandler);
+    int flags;
+} builtin;
 
 static bool env_var_delete (ListHandler);
 static bool env_var_set (ListHandler);
+static bool export_cmd (ListHandler);
+static bool unset_cmd (ListHandler);
+static bool is_assign_line (ListHandler);
+static bool assign_vars (ListHandler);
 static bool change_directory (ListHandler);
-static bool print_wdirectory ();
+static bool print_wdirectory (ListHandler);
+static bool hash_cmds (ListHandler);
+static bool cmd_cache_ctl (ListHandler);
+static job *get_job (ListHandler, const char *);
+static bool list_jobs (ListHandler);
+static bool wait_jobs (ListHandler);
+static bool wait_job (job *);
+static bool foreground_job (ListHandler);
+static bool background_job (ListHandler);
+static bool parallel_cmd (ListHandler);
+static bool time_cmd (ListHandler);
+static bool stats_cmd (ListHandler);
+static bool bench_cmd (ListHandler);
+static bool pipe_cmd (ListHandler);
+static bool batch_cmd (ListHandler);
+static bool history_cmd (ListHandler);
+static bool fanout_cmd (ListHandler);
+static double bench_run (ListHandler, const pipeline *, bool, double *,
+    bool *);
+static int cmp_double (const void *, const void *);
+static double rank (const double *, int, double);
+static bool exit_cmd (ListHandler);
+static void exit_summary ();
+static const builtin *find_builtin (const char *);
+static unsigned long hash_name (const char *, unsigned long);
+static void build_slots ();
+static bool run_redirected (const builtin *, ListHandler);
+static int move_fd (int, int);
+static void restore_fd (int, int);
+
+/* every internal command. Each returns true if it failed */
+static const builtin builtins[] = {
+    {"setenv", env_var_set, 0},
+    {"unsetenv", env_var_delete, 0},
+    {"export", export_cmd, 0},
+    {"unset", unset_cmd, 0},
+    {"cd", change_directory, 0},
+    {"pwd", print_wdirectory, BI_PURE},
+    {"hash", hash_cmds, 0},
+    {"cmdcache", cmd_cache_ctl, 0},
+    {"jobs", list_jobs, 0},
+    {"wait", wait_jobs, 0},
+    {"fg", foreground_job, 0},
+    {"bg", background_job, 0},
+    {"parallel", parallel_cmd, BI_WHOLE_LINE},
+    {"time", time_cmd, BI_WHOLE_LINE},
+    {"stats", stats_cmd, 0},
+    {"bench", bench_cmd, BI_WHOLE_LINE},
+    {"pipe", pipe_cmd, BI_WHOLE_LINE},
+    {"batch", batch_cmd, BI_WHOLE_LINE},
+    {"history", history_cmd, 0},
+    {"exit", exit_cmd, 0},
+    {"echo", echo_cmd, BI_PURE},
+    {"true", true_cmd, BI_STATUS | BI_PURE},
+    {"false", false_cmd, BI_STATUS | BI_PURE},
+    {"test", test_cmd, BI_STATUS | BI_PURE},
+    {"[", test_cmd, BI_STATUS | BI_PURE},
+    {"printf", printf_cmd, BI_PURE},
+    {"read", read_cmd, BI_STATUS},
+    {"cat", cat_cmd, BI_PURE},
+    {"fanout", fanout_cmd, BI_STATUS},
+};
+
+#define BUILTIN_CT (int)(sizeof(builtins) / sizeof(builtins[0]))
+#define SLOT_BITS 7
+#define SLOT_CT (1 << SLOT_BITS) // at least twice BUILTIN_CT
+
+_Static_assert(SLOT_CT >= 2 * BUILTIN_CT, "too many builtins for SLOT_CT");
+
+/* builtins by hash, index + 1 or 0 if empty. The seed is picked so no two
+ * names share a slot, so a lookup is one hash and one strcmp */
+static unsigned char slots[SLOT_CT];
+static unsigned long slot_seed = 0;
+
+/**
+ * true if name is an internal command
+ */
+bool is_internal_cmd (const char *name)
+{
+    return find_builtin(name) != NULL;
+}
+
+/**
+ * true if a line runs in the shell instead of through execute. That's
+ * when it starts with a builtin that is either the only stage or takes
+ * the whole line itself, like time, or only sets variables
+ */
+bool is_shell_line (ListHandler tlist, const pipeline *pl)
+{
+    const builtin *b = find_builtin(tlist.head[0].token);
+    if (b == NULL) {
+        return is_assign_line(tlist);
+    }
+    return pl->count == 1 || (b->flags & BI_WHOLE_LINE);
+}
+
+/**
+ * true if a line is a single builtin that only prints, which $(cmd)
+ * can run in the shell with its stdout captured
+ */
+bool is_pure_line (ListHandler tlist, const pipeline *pl)
+{
+    const builtin *b = find_builtin(tlist.head[0].token);
+    return b != NULL && (b->flags & BI_PURE) && pl->count == 1 &&
+        !pl->background;
+}
+
+/**
+ * runs the builtin argv[0] as a stage of a pipeline, in a forked copy of
+ * the shell that already has its pipes and redirects on stdin and
+ * stdout. Returns its exit status
+ */
+int run_builtin_argv (char **argv, int argc)
+{
+    const builtin *b = find_builtin(argv[0]);
+    if (b == NULL) {
+        return 127;
+    }
+    tok_node *nodes = malloc(sizeof(tok_node) * (argc + 1));
+    if (nodes == NULL) {
+        perror("malloc failed in run_builtin_argv");
+        exit(-1);
+    }
+    for (int i = 0; i < argc; i++) {
+        nodes[i].token = argv[i];
+        nodes[i].special = false;
+    }
+    ListHandler tlist = {nodes, argc, 0, NULL};
+    bool failed = b->run(tlist);
+    fflush(stdout);
+    free(nodes);
+    return failed ? 1 : 0;
+}
 
 /**
  * Runs a given internal command as long as it's
- * valid
+ * valid. Returns 1 if it isn't an internal command, -1 if it failed
+ * and 0 if it ran. Commands that fail as their exit status, like test,
+ * always return 0
  */
 int run_internal_cmd (ListHandler tlist) {
-    bool found_internal_cmd = false;
-    bool err_found = false;
-    char *token = ((tok_node *)tlist.head)->token;
-    if (!strcmp(token, "setenv")) {
-        /* set an environment variable */
-        err_found = env_var_set(tlist);
-        found_internal_cmd = true;
-    } else if (!strcmp(token, "unsetenv")) {
-        /* delete an environment variable */
-        err_found = env_var_delete(tlist);
-        found_internal_cmd = true;
-    } else if (!strcmp(token, "cd")) {
-        /* change directory */
-        err_found = change_directory(tlist);
-        found_internal_cmd = true;
-    } else if (!strcmp(token, "pwd")) {
-        /* print the current working directory */
-        print_wdirectory();
-        found_internal_cmd = true;
-    } else if (!strcmp(token, "exit")) {
-        /* print accounting info and exit */
-        free_tok_list(&tlist);
-        found_internal_cmd = true;
-        exit(0);
-    }
-    if (found_internal_cmd) {
-        if (err_found) {
-            return -1; // found, but error
-        } else {
-            return 0; // found, no error
+    const builtin *b = find_builtin(tlist.head[0].token);
+    if (b == NULL) {
+        if (is_assign_line(tlist)) {
+            return assign_vars(tlist) ? -1 : 0;
         }
-    } else {
         return 1; // not found
     }
+    bool failed;
+    if (b->flags & BI_WHOLE_LINE) {
+        failed = b->run(tlist);
+    } else {
+        failed = run_redirected(b, tlist);
+    }
+    if (failed && !(b->flags & BI_STATUS)) {
+        return -1; // found, but error
+    }
+    return 0; // found, no error
 }
 
 /**
@@ -66,13 +215,16 @@ int run_internal_cmd (ListHandler tlist) {
  */
 static bool env_var_set (ListHandler tlist)
 {
-    char *env_var_name = ((tok_node *)tlist.head)->next->token;
-    char *env_var_val = ((tok_node *)tlist.tail)->token;
     if (tlist.count == 3) {
-        if(setenv(env_var_name, env_var_val, 1)) {
-            perror("couldn't set env var");
+        char *env_var_name = tlist.head[1].token;
+        char *env_var_val = tlist.head[2].token;
+        if (!var_set(env_var_name, env_var_val, true)) {
+            fprintf(stderr, "setenv: %s: not a valid name\n", env_var_name);
             return true; // error
         }
+        if (!strcmp(env_var_name, "PATH")) {
+            path_cache_invalidate();
+        }
     } else {
         fprintf(stderr, "setenv takes 2 arguments");
         return true; // error
@@ -86,9 +238,9 @@ static bool env_var_set (ListHandler tlist)
 static bool env_var_delete (ListHandler tlist)
 {
     if (tlist.count == 2) {
-        if(unsetenv(((tok_node *)tlist.tail)->token)) {
-            perror("couldn't delete");
-            return true; // error
+        var_unset(tlist.head[1].token);
+        if (!strcmp(tlist.head[1].token, "PATH")) {
+            path_cache_invalidate();
         }
     } else {
         fprintf(stderr, "unsetenv takes 1 argument");
@@ -97,6 +249,82 @@ static bool env_var_delete (ListHandler tlist)
     return false; // no error
 }
 
+/**
+ * export [name[=value]...]
+ * puts variables in the environment of the commands the shell runs,
+ * setting them first if given a value. With no names it prints the
+ * environment
+ */
+static bool export_cmd (ListHandler tlist)
+{
+    if (tlist.count == 1) {
+        var_print(true);
+        return false;
+    }
+    bool failed = false;
+    for (int i = 1; i < tlist.count; i++) {
+        char *arg = tlist.head[i].token;
+        size_t len = var_assign_len(arg);
+        if (len > 0) {
+            var_setn(arg, len, arg + len + 1, true);
+            if (len == 4 && !strncmp(arg, "PATH", 4)) {
+                path_cache_invalidate();
+            }
+        } else if (!var_name_ok(arg, strlen(arg))) {
+            fprintf(stderr, "export: %s: not a valid name\n", arg);
+            failed = true;
+        } else if (!var_export(arg)) {
+            var_set(arg, "", true);
+        }
+    }
+    return failed;
+}
+
+/**
+ * unset name...
+ * removes variables, from the environment too
+ */
+static bool unset_cmd (ListHandler tlist)
+{
+    for (int i = 1; i < tlist.count; i++) {
+        var_unset(tlist.head[i].token);
+        if (!strcmp(tlist.head[i].token, "PATH")) {
+            path_cache_invalidate();
+        }
+    }
+    return false;
+}
+
+/**
+ * true if every word of a line is a NAME=value assignment
+ */
+static bool is_assign_line (ListHandler tlist)
+{
+    for (int i = 0; i < tlist.count; i++) {
+        if (tlist.head[i].special || var_assign_len(tlist.head[i].token) == 0) {
+            return false;
+        }
+    }
+    return tlist.count > 0;
+}
+
+/**
+ * sets the shell variable each NAME=value word of a line names. They
+ * stay out of the environment unless already exported
+ */
+static bool assign_vars (ListHandler tlist)
+{
+    for (int i = 0; i < tlist.count; i++) {
+        char *word = tlist.head[i].token;
+        size_t len = var_assign_len(word);
+        var_setn(word, len, word + len + 1, false);
+        if (len == 4 && !strncmp(word, "PATH", 4)) {
+            path_cache_invalidate();
+        }
+    }
+    return false;
+}
+
 /**
  * change to a give directory.
  * ~ == HOME
@@ -104,15 +332,15 @@ static bool env_var_delete (ListHandler tlist)
 static bool change_directory (ListHandler tlist)
 {
     if (tlist.count == 2) {
-        if ((((tok_node *)tlist.head)->next->token)[0] == '~') {
-            const char *home = getenv("HOME");
+        if (tlist.head[1].token[0] == '~') {
+            const char *home = var_get("HOME");
             char tmpstr[strlen(home)+1];
             strcpy(tmpstr, home);
-            const char *fpath = strcat(tmpstr, &(((tok_node *)tlist.tail)->token)[1]);
+            const char *fpath = strcat(tmpstr, &tlist.head[1].token[1]);
             chdir(fpath);
             return false; // no error
         }
-        chdir(((tok_node *)tlist.tail)->token);
+        chdir(tlist.head[1].token);
     } else {
         fprintf(stderr, "cd takes 1 argument\n");
         return true; // error
@@ -123,7 +351,7 @@ static bool change_directory (ListHandler tlist)
 /**
  * print the current working directory to STDOUT
  */
-static bool print_wdirectory ()
+static bool print_wdirectory (ListHandler tlist)
 {
     char buff[BUFF_SIZE];
     if (getcwd(buff, BUFF_SIZE) == NULL) {
@@ -133,3 +361,884 @@ static bool print_wdirectory ()
     printf("%s\n", buff);
     return false; // no error
 }
+
+/**
+ * hash             list remembered commands
+ * hash -r          forget all remembered commands
+ * hash -p path cmd remember path as the location of cmd
+ * hash cmd...      look up each cmd in $PATH and remember it
+ */
+static bool hash_cmds (ListHandler tlist)
+{
+    if (tlist.count == 1) {
+        path_cache_print();
+        return false; // no error
+    }
+    char *arg = tlist.head[1].token;
+    if (!strcmp(arg, "-r")) {
+        path_cache_clear();
+        return false; // no error
+    }
+    if (!strcmp(arg, "-p")) {
+        if (tlist.count != 4) {
+            fprintf(stderr, "hash -p takes a path and a command\n");
+            return true; // error
+        }
+        path_cache_add(tlist.head[2].token, tlist.head[3].token);
+        return false; // no error
+    }
+    bool err = false;
+    for (int i = 1; i < tlist.count; i++) {
+        if (!path_cache_remember(tlist.head[i].token)) {
+            fprintf(stderr, "hash: %s: not found\n", tlist.head[i].token);
+            err = true;
+        }
+    }
+    return err;
+}
+
+/**
+ * cmdcache         print hit/miss counters
+ * cmdcache -c      forget every cached line
+ * cmdcache -s n    keep at most n lines, 0 turns the cache off
+ */
+static bool cmd_cache_ctl (ListHandler tlist)
+{
+    if (tlist.count == 1) {
+        cmd_cache_print();
+        return false; // no error
+    }
+    char *arg = tlist.head[1].token;
+    if (!strcmp(arg, "-c") && tlist.count == 2) {
+        cmd_cache_clear();
+        return false; // no error
+    }
+    if (!strcmp(arg, "-s") && tlist.count == 3) {
+        char *end;
+        long size = strtol(tlist.head[2].token, &end, 10);
+        if (*end != '\0' || size < 0) {
+            fprintf(stderr, "cmdcache: bad size %s\n", tlist.head[2].token);
+            return true; // error
+        }
+        cmd_cache_resize(size);
+        return false; // no error
+    }
+    fprintf(stderr, "usage: cmdcache [-c] [-s size]\n");
+    return true; // error
+}
+
+/**
+ * finds the job named by the first argument, %n or n, or the newest
+ * job if there isn't one. Prints an error and returns NULL if there is
+ * no such job
+ */
+static job *get_job (ListHandler tlist, const char *name)
+{
+    if (tlist.count > 2) {
+        fprintf(stderr, "%s takes at most 1 argument\n", name);
+        return NULL;
+    }
+    int id = 0;
+    if (tlist.count == 2) {
+        char *arg = tlist.head[1].token;
+        char *end;
+        id = strtol(arg[0] == '%' ? arg + 1 : arg, &end, 10);
+        if (*end != '\0' || id <= 0) {
+            fprintf(stderr, "%s: bad job %s\n", name, arg);
+            return NULL;
+        }
+    }
+    jobs_update();
+    job *j = job_find(id);
+    if (j == NULL) {
+        fprintf(stderr, "%s: no such job\n", name);
+    }
+    return j;
+}
+
+/**
+ * jobs             list every job and whether it is running
+ */
+static bool list_jobs (ListHandler tlist)
+{
+    jobs_print();
+    return false; // no error
+}
+
+/**
+ * wait             wait for every running job to finish
+ * wait n           wait for job n to finish
+ * a job that is or becomes stopped is left in the table, as waiting on
+ * it would never end
+ */
+static bool wait_jobs (ListHandler tlist)
+{
+    if (tlist.count == 1) {
+        jobs_update();
+        job *j = jobs_first();
+        while (j != NULL) {
+            job *next = j->next;
+            if (!j->stopped) {
+                wait_job(j);
+            }
+            j = next;
+        }
+        return false; // no error
+    }
+    job *j = get_job(tlist, "wait");
+    if (j == NULL) {
+        return true; // error
+    }
+    if (j->stopped) {
+        fprintf(stderr, "wait: job %d is stopped\n", j->id);
+        return true; // error
+    }
+    return wait_job(j);
+}
+
+/**
+ * waits for the stages of a job and removes it, unless it stops first.
+ * Returns true if it stopped
+ */
+static bool wait_job (job *j)
+{
+    if (wait_stages(j->pids, j->status, j->usage, j->count, true)) {
+        j->stopped = true;
+        printf("[%d]+  Stopped\t\t%s\n", j->id, j->cmd);
+        return true;
+    }
+    job_remove(j);
+    return false;
+}
+
+/**
+ * fg [n]           continue job n, or the newest, in the foreground
+ */
+static bool foreground_job (ListHandler tlist)
+{
+    job *j = get_job(tlist, "fg");
+    if (j == NULL) {
+        return true; // error
+    }
+    resume_job(j, true);
+    return false; // no error
+}
+
+/**
+ * bg [n]           continue job n, or the newest, in the background
+ */
+static bool background_job (ListHandler tlist)
+{
+    job *j = get_job(tlist, "bg");
+    if (j == NULL) {
+        return true; // error
+    }
+    resume_job(j, false);
+    return false; // no error
+}
+
+/**
+ * parallel [-j n] [-k] cmd [arg...] ::: input...
+ * parallel [-j n] [-k] cmd [arg...]     inputs read from stdin, one per line
+ * runs cmd once per input, n at a time (one per cpu by default). Every
+ * {} in cmd is replaced by the input, which is added at the end if there
+ * is no {}. Outputs are printed as jobs finish, or in input order with -k
+ */
+static bool parallel_cmd (ListHandler tlist)
+{
+    long max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool keep_order = false;
+    int i = 1;
+    for (; i < tlist.count; i++) {
+        char *arg = tlist.head[i].token;
+        if (!strcmp(arg, "-k")) {
+            keep_order = true;
+        } else if (!strcmp(arg, "-j") && i + 1 < tlist.count) {
+            char *end;
+            max_jobs = strtol(tlist.head[++i].token, &end, 10);
+            if (*end != '\0' || max_jobs <= 0) {
+                fprintf(stderr, "parallel: bad job count %s\n",
+                    tlist.head[i].token);
+                return true; // error
+            }
+        } else {
+            break;
+        }
+    }
+    if (max_jobs <= 0) {
+        max_jobs = 1;
+    }
+
+    /* the command is everything up to ::: */
+    int cmd_start = i;
+    while (i < tlist.count && strcmp(tlist.head[i].token, ":::")) {
+        if (tlist.head[i].special && !strcmp(tlist.head[i].token, "|")) {
+            fprintf(stderr, "parallel: can't run a pipeline\n");
+            return true; // error
+        }
+        i++;
+    }
+    if (i == cmd_start) {
+        fprintf(stderr, "usage: parallel [-j n] [-k] cmd [arg...] "
+            "[::: input...]\n");
+        return true; // error
+    }
+
+    /* everything for this run lives in its own arena */
+    arena mem = {NULL};
+    ListHandler cmd = tlist;
+    cmd.head += cmd_start;
+    cmd.count = i - cmd_start;
+    cmd.cap = 0;
+    cmd.mem = &mem;
+    pipeline pl;
+    build_pipeline(cmd, &pl);
+
+    char **inputs;
+    int input_ct = 0;
+    if (i < tlist.count) {
+        input_ct = tlist.count - i - 1;
+        inputs = arena_alloc(&mem, sizeof(char *) * (input_ct + 1));
+        for (int k = 0; k < input_ct; k++) {
+            /* the whole line is ours, so a | here isn't an input */
+            if (tlist.head[i + 1 + k].special
+                && !strcmp(tlist.head[i + 1 + k].token, "|")) {
+                fprintf(stderr, "parallel: can't pipe its output\n");
+                arena_free(&mem);
+                return true; // error
+            }
+            inputs[k] = tlist.head[i + 1 + k].token;
+        }
+    } else {
+        int cap = 64;
+        inputs = arena_alloc(&mem, sizeof(char *) * cap);
+        line_reader in;
+        reader_init(&in, STDIN_FILENO);
+        char *line;
+        ssize_t length;
+        while ((length = read_line(&in, &line)) >= 0) {
+            if (input_ct == cap) {
+                char **tmp = arena_alloc(&mem, sizeof(char *) * cap * 2);
+                memcpy(tmp, inputs, sizeof(char *) * cap);
+                inputs = tmp;
+                cap *= 2;
+            }
+            char *copy = arena_alloc(&mem, length);
+            memcpy(copy, line, length - 1);
+            copy[length - 1] = '\0'; // in place of the \n
+            inputs[input_ct++] = copy;
+        }
+        reader_free(&in);
+    }
+
+    run_parallel(&pl.stages[0], inputs, input_ct, max_jobs, keep_order,
+        &mem);
+    arena_free(&mem);
+    return false; // no error
+}
+
+/**
+ * time cmd...      runs cmd and prints the wall time, cpu, memory, page
+ *                  faults and context switches of each stage and in total
+ */
+static bool time_cmd (ListHandler tlist)
+{
+    if (tlist.count < 2) {
+        fprintf(stderr, "usage: time cmd [arg...]\n");
+        return true; // error
+    }
+    ListHandler cmd = tlist;
+    cmd.head++;
+    cmd.count--;
+    cmd.cap = 0;
+    arena mem = {NULL};
+    cmd.mem = &mem;
+    pipeline pl;
+    build_pipeline(cmd, &pl);
+
+    /* builtins run in the shell, so time them by the shell's own usage
+     * and that of any children they waited for */
+    if (is_shell_line(cmd, &pl)) {
+        struct rusage self0, kids0, self1, kids1;
+        cmd_usage self, kids, total = {0};
+        acct_start(&self);
+        kids = self;
+        getrusage(RUSAGE_SELF, &self0);
+        getrusage(RUSAGE_CHILDREN, &kids0);
+        bool err = run_internal_cmd(cmd) < 0;
+        getrusage(RUSAGE_SELF, &self1);
+        getrusage(RUSAGE_CHILDREN, &kids1);
+        acct_since(&self, &self0, &self1);
+        acct_since(&kids, &kids0, &kids1);
+        acct_add(&total, &self);
+        acct_add(&total, &kids);
+        acct_print_header(stderr);
+        acct_print(stderr, "shell", &self, cmd.head[0].token);
+        acct_print(stderr, "kids", &kids, NULL);
+        acct_print(stderr, "total", &total, NULL);
+        arena_free(&mem);
+        return err;
+    }
+
+    execute(&pl);
+
+    const cmd_usage *usage;
+    int first;
+    int stage_ct = last_pipe_usage(&usage, &first);
+    cmd_usage total = {0};
+    acct_print_header(stderr);
+    for (int i = 0; i < stage_ct; i++) {
+        char name[16];
+        pipeline one = {&pl.stages[first + i], 1, false};
+        char *text = pipeline_text(&one);
+        snprintf(name, sizeof(name), "%d", first + i + 1);
+        acct_print(stderr, name, &usage[i], text);
+        free(text);
+        acct_add(&total, &usage[i]);
+    }
+    if (stage_ct > 1) {
+        acct_print(stderr, "total", &total, NULL);
+    }
+    arena_free(&mem);
+    return false; // no error
+}
+
+/**
+ * stats            print the counters and time spent in each phase
+ * stats -r         zero them
+ * stats on|off     start or stop timing phases
+ */
+static bool stats_cmd (ListHandler tlist)
+{
+    if (tlist.count == 1) {
+        trace_print();
+        return false; // no error
+    }
+    char *arg = tlist.head[1].token;
+    if (tlist.count == 2 && !strcmp(arg, "-r")) {
+        trace_reset();
+    } else if (tlist.count == 2 && !strcmp(arg, "on")) {
+        trace_enable(true);
+    } else if (tlist.count == 2 && !strcmp(arg, "off")) {
+        trace_enable(false);
+    } else {
+        fprintf(stderr, "usage: stats [-r | on | off]\n");
+        return true; // error
+    }
+    return false; // no error
+}
+
+/**
+ * bench [-n runs] [-w warmup] [-c] cmd...
+ *                  runs cmd warmup times untimed, then runs times more
+ *                  and prints the min, p50, p90, p99 and max wall time,
+ *                  the mean cpu time and commands per second. -c prints
+ *                  them as csv. The line is only tokenized once
+ */
+static bool bench_cmd (ListHandler tlist)
+{
+    long runs = 100;
+    long warmup = 3;
+    bool csv = false;
+    int i = 1;
+    for (; i < tlist.count; i++) {
+        char *arg = tlist.head[i].token;
+        if (!strcmp(arg, "-c")) {
+            csv = true;
+        } else if (!strcmp(arg, "-n") && i + 1 < tlist.count) {
+            char *end;
+            runs = strtol(tlist.head[++i].token, &end, 10);
+            if (*end != '\0' || runs <= 0) {
+                fprintf(stderr, "bench: bad run count %s\n",
+                    tlist.head[i].token);
+                return true; // error
+            }
+        } else if (!strcmp(arg, "-w") && i + 1 < tlist.count) {
+            char *end;
+            warmup = strtol(tlist.head[++i].token, &end, 10);
+            if (*end != '\0' || warmup < 0) {
+                fprintf(stderr, "bench: bad warmup count %s\n",
+                    tlist.head[i].token);
+                return true; // error
+            }
+        } else {
+            break;
+        }
+    }
+    if (i == tlist.count) {
+        fprintf(stderr, "usage: bench [-n runs] [-w warmup] [-c] cmd "
+            "[arg...]\n");
+        return true; // error
+    }
+
+    ListHandler cmd = tlist;
+    cmd.head += i;
+    cmd.count -= i;
+    cmd.cap = 0;
+    arena mem = {NULL};
+    cmd.mem = &mem;
+    pipeline pl;
+    build_pipeline(cmd, &pl);
+    bool in_shell = is_shell_line(cmd, &pl);
+
+    double *wall = malloc(sizeof(double) * runs);
+    if (wall == NULL) {
+        perror("malloc failed in bench_cmd");
+        exit(-1);
+    }
+    double cpu = 0, total = 0;
+    bool stop = false;
+    for (long k = 0; k < warmup && !stop; k++) {
+        double ignored;
+        bench_run(cmd, &pl, in_shell, &ignored, &stop);
+    }
+    long done = 0;
+    while (done < runs && !stop) {
+        double used;
+        wall[done] = bench_run(cmd, &pl, in_shell, &used, &stop);
+        total += wall[done];
+        cpu += used;
+        done++;
+    }
+    arena_free(&mem);
+    if (done == 0) {
+        free(wall);
+        return true; // error, interrupted before anything was timed
+    }
+
+    qsort(wall, done, sizeof(double), cmp_double);
+    double ms[] = {
+        wall[0], rank(wall, done, 50), rank(wall, done, 90),
+        rank(wall, done, 99), wall[done - 1], cpu / done
+    };
+    for (int m = 0; m < 6; m++) {
+        ms[m] *= 1e3;
+    }
+    double rate = total > 0 ? done / total : 0;
+    if (csv) {
+        fprintf(stderr, "runs,min_ms,p50_ms,p90_ms,p99_ms,max_ms,cpu_ms,"
+            "cmds_per_sec\n");
+        fprintf(stderr, "%ld,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.1f\n", done,
+            ms[0], ms[1], ms[2], ms[3], ms[4], ms[5], rate);
+    } else {
+        fprintf(stderr, "%ld runs%s\n", done, stop ? " (interrupted)" : "");
+        fprintf(stderr, "%10s %10s %10s %10s %10s\n",
+            "min", "p50", "p90", "p99", "max");
+        fprintf(stderr, "%8.3fms %8.3fms %8.3fms %8.3fms %8.3fms\n",
+            ms[0], ms[1], ms[2], ms[3], ms[4]);
+        fprintf(stderr, "cpu %.3fms mean, %.1f cmds/sec\n", ms[5], rate);
+    }
+    free(wall);
+    return false; // no error
+}
+
+/**
+ * pipe [-s size] [-m] cmd | cmd...
+ *                  runs a pipeline with pipes of size bytes (k and m
+ *                  suffixes work, max for the most allowed). -m relays
+ *                  each pipe and reports the bytes that went through it,
+ *                  how fast, and how long it sat empty waiting on its
+ *                  writer or full waiting on its reader. Setting
+ *                  MYCLI_PIPE_SIZE or MYCLI_PIPE_METER does the same for
+ *                  every pipeline
+ */
+static bool pipe_cmd (ListHandler tlist)
+{
+    long size = 0;
+    bool meter = false;
+    int i = 1;
+    for (; i < tlist.count; i++) {
+        char *arg = tlist.head[i].token;
+        if (!strcmp(arg, "-m")) {
+            meter = true;
+        } else if (!strcmp(arg, "-s") && i + 1 < tlist.count) {
+            size = parse_pipe_size(tlist.head[++i].token);
+            if (size < 0) {
+                fprintf(stderr, "pipe: bad size %s\n", tlist.head[i].token);
+                return true; // error
+            }
+        } else {
+            break;
+        }
+    }
+    if (i == tlist.count) {
+        fprintf(stderr, "usage: pipe [-s size] [-m] cmd | cmd...\n");
+        return true; // error
+    }
+
+    ListHandler cmd = tlist;
+    cmd.head += i;
+    cmd.count -= i;
+    cmd.cap = 0;
+    arena mem = {NULL};
+    cmd.mem = &mem;
+    pipeline pl;
+    build_pipeline(cmd, &pl);
+    pl.pipe_size = size;
+    pl.meter = meter;
+    execute(&pl);
+    arena_free(&mem);
+    return false; // no error
+}
+
+/**
+ * batch [-P jobs] [-k n] cmd arg... [| cmd...]
+ *                  runs cmd, and if its args are too many for one exec,
+ *                  as few execs as they fit in, each starting with the
+ *                  first n args (the options by default). -P runs up to
+ *                  jobs of them at once. Setting MYCLI_BATCH to a list
+ *                  of cmds does the same for them everywhere
+ */
+static bool batch_cmd (ListHandler tlist)
+{
+    int jobs = 1, keep = -1;
+    int i = 1;
+    for (; i + 1 < tlist.count; i++) {
+        char *arg = tlist.head[i].token;
+        int *opt = !strcmp(arg, "-P") ? &jobs : !strcmp(arg, "-k") ? &keep :
+            NULL;
+        if (opt == NULL) {
+            break;
+        }
+        char *end;
+        long n = strtol(tlist.head[++i].token, &end, 10);
+        if (*end != '\0' || n < 0 || (opt == &jobs && n < 1)) {
+            fprintf(stderr, "batch: bad number %s\n", tlist.head[i].token);
+            return true; // error
+        }
+        *opt = n;
+    }
+    if (i >= tlist.count || tlist.head[i].special) {
+        fprintf(stderr, "usage: batch [-P jobs] [-k n] cmd arg...\n");
+        return true; // error
+    }
+
+    ListHandler cmd = tlist;
+    cmd.head += i;
+    cmd.count -= i;
+    cmd.cap = 0;
+    arena mem = {NULL};
+    cmd.mem = &mem;
+    pipeline pl;
+    build_pipeline(cmd, &pl);
+    stage *st = &pl.stages[0];
+    st->batch = true;
+    st->batch_keep = keep >= 0 ? keep : batch_leading_opts(st->argv, st->argc);
+    st->batch_jobs = jobs;
+    execute(&pl);
+    arena_free(&mem);
+    return false; // no error
+}
+
+/**
+ * history [n]              prints the last n lines typed, or all of
+ *                          them, with when each ran, for how long, its
+ *                          status and where
+ * history search text      prints the lines with text in them
+ */
+static bool history_cmd (ListHandler tlist)
+{
+    if (tlist.count >= 2 && !strcmp(tlist.head[1].token, "search")) {
+        if (tlist.count != 3) {
+            fprintf(stderr, "usage: history search text\n");
+            return true; // error
+        }
+        return history_search(tlist.head[2].token);
+    }
+    long n = -1;
+    if (tlist.count == 2) {
+        char *end;
+        n = strtol(tlist.head[1].token, &end, 10);
+        if (*end != '\0' || n < 0) {
+            fprintf(stderr, "history: bad number %s\n", tlist.head[1].token);
+            return true; // error
+        }
+    } else if (tlist.count > 2) {
+        fprintf(stderr, "usage: history [n]\n");
+        return true; // error
+    }
+    return history_print(n);
+}
+
+/**
+ * fanout [-s size] cmd...  gives every cmd, each one quoted command,
+ *                          its own copy of stdin. The copies are made
+ *                          in the kernel, with size byte pipes, and
+ *                          the slowest cmd sets the pace for all
+ */
+static bool fanout_cmd (ListHandler tlist)
+{
+    long size = 0;
+    int i = 1;
+    if (i + 1 < tlist.count && !strcmp(tlist.head[i].token, "-s")) {
+        size = parse_pipe_size(tlist.head[++i].token);
+        if (size < 0) {
+            fprintf(stderr, "fanout: bad size %s\n", tlist.head[i].token);
+            return true; // error
+        }
+        i++;
+    }
+    if (i == tlist.count) {
+        fprintf(stderr, "usage: fanout [-s size] cmd...\n");
+        return true; // error
+    }
+
+    /* each cmd is a line of its own, tokenized into this arena */
+    arena mem = {NULL};
+    int count = tlist.count - i;
+    stage cmds[count];
+    for (int k = 0; k < count; k++) {
+        char *arg = tlist.head[i + k].token;
+        size_t len = strlen(arg);
+        char *line = arena_alloc(&mem, len + 1);
+        memcpy(line, arg, len);
+        line[len] = '\n';
+        ListHandler cmd = {NULL, 0, 0, &mem};
+        tokenize(&cmd, line, len + 1);
+        pipeline pl;
+        if (cmd.count > 0) {
+            build_pipeline(cmd, &pl);
+        }
+        if (cmd.count == 0 || pl.count != 1 || pl.background) {
+            fprintf(stderr, "fanout: %s isn't a single command\n", arg);
+            arena_free(&mem);
+            return true; // error
+        }
+        cmds[k] = pl.stages[0];
+    }
+    int status = run_fanout(cmds, count, size);
+    arena_free(&mem);
+    return status != 0;
+}
+
+/**
+ * runs cmd once, in the shell or through execute, and returns
+ * the wall time in seconds. cpu is set to the cpu seconds it used and
+ * stop to true if it was interrupted or stopped
+ */
+static double bench_run (ListHandler cmd, const pipeline *pl, bool in_shell,
+    double *cpu, bool *stop)
+{
+    cmd_usage used;
+    acct_start(&used);
+    if (in_shell) {
+        struct rusage self0, kids0, self1, kids1;
+        cmd_usage kids = used;
+        getrusage(RUSAGE_SELF, &self0);
+        getrusage(RUSAGE_CHILDREN, &kids0);
+        run_internal_cmd(cmd);
+        getrusage(RUSAGE_SELF, &self1);
+        getrusage(RUSAGE_CHILDREN, &kids1);
+        acct_since(&used, &self0, &self1);
+        acct_since(&kids, &kids0, &kids1);
+        *cpu = used.user + used.sys + kids.user + kids.sys;
+        return used.wall;
+    }
+
+    int status = execute(pl);
+    double wall = acct_now() - used.start;
+    const cmd_usage *usage;
+    int first;
+    int stage_ct = last_pipe_usage(&usage, &first);
+    *cpu = 0;
+    for (int i = 0; i < stage_ct; i++) {
+        *cpu += usage[i].user + usage[i].sys;
+    }
+    if (status == 128 + SIGINT || status == 128 + SIGTSTP) {
+        *stop = true;
+    }
+    return wall;
+}
+
+/**
+ * qsort comparator for doubles, smallest first
+ */
+static int cmp_double (const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * nearest rank percentile p of n sorted values
+ */
+static double rank (const double *v, int n, double p)
+{
+    int r = (int)(p / 100 * n + 0.999999);
+    return v[r < 1 ? 0 : r - 1];
+}
+
+/**
+ * prints the session's accounting on the way out, to the file named by
+ * $MYCLI_ACCOUNTING if it is set, else to stderr
+ */
+static void exit_summary ()
+{
+    const char *file = var_get("MYCLI_ACCOUNTING");
+    FILE *out = stderr;
+    if (file != NULL && (out = fopen(file, "a")) == NULL) {
+        perror(file);
+        out = stderr;
+    }
+    acct_summary(out);
+    if (out != stderr) {
+        fclose(out);
+    }
+}
+
+/**
+ * exit             print accounting info and exit
+ */
+static bool exit_cmd (ListHandler tlist)
+{
+    exit_summary();
+    exit(0);
+}
+
+/**
+ * finds the table entry for a builtin, NULL if name isn't one
+ */
+static const builtin *find_builtin (const char *name)
+{
+    if (slot_seed == 0) {
+        build_slots();
+    }
+    int i = slots[hash_name(name, slot_seed)];
+    if (i == 0 || strcmp(builtins[i - 1].name, name)) {
+        return NULL;
+    }
+    return &builtins[i - 1];
+}
+
+/**
+ * FNV-1a hash of a name, scrambled by multiplying with seed and cut
+ * down to a slot from the top bits
+ */
+static unsigned long hash_name (const char *s, unsigned long seed)
+{
+    unsigned long h = 14695981039346656037UL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211UL;
+    }
+    return (h * seed) >> (64 - SLOT_BITS);
+}
+
+/**
+ * tries seeds until every builtin hashes to its own slot. With the table
+ * at most half full one turns up after a few tries
+ */
+static void build_slots ()
+{
+    unsigned long seed = 0x9e3779b97f4a7c15UL; // odd, so no bits are lost
+    bool perfect = false;
+    while (!perfect) {
+        seed += 2;
+        memset(slots, 0, sizeof(slots));
+        perfect = true;
+        for (int i = 0; i < BUILTIN_CT && perfect; i++) {
+            unsigned char *slot = &slots[hash_name(builtins[i].name, seed)];
+            perfect = (*slot == 0);
+            *slot = i + 1;
+        }
+    }
+    slot_seed = seed;
+}
+
+/**
+ * runs a builtin on the args before its first redirect, with its
+ * redirects put on the shell's own stdin and stdout. Both are put back
+ * when it's done, so nothing is forked
+ */
+static bool run_redirected (const builtin *b, ListHandler tlist)
+{
+    int argc = 0;
+    while (argc < tlist.count && !tlist.head[argc].special) {
+        argc++;
+    }
+    if (argc == tlist.count) {
+        return b->run(tlist); // nothing to redirect
+    }
+
+    /* the words after the args are only redirects and their files */
+    redirect *redirs = malloc(sizeof(redirect) * (tlist.count - argc));
+    if (redirs == NULL) {
+        perror("malloc failed in run_redirected");
+        exit(-1);
+    }
+    stage st = {NULL, argc, redirs, 0};
+    for (int i = argc; i + 1 < tlist.count; i++) {
+        char *op = tlist.head[i].token;
+        if (!tlist.head[i].special) {
+            continue;
+        }
+        redirect *r = &redirs[st.redir_ct];
+        if (!strcmp(op, "<")) {
+            r->rw = READ;
+            r->append = false;
+        } else if (!strcmp(op, "<<") || !strcmp(op, "<<<")) {
+            r->rw = op[2] ? HERE_STRING : HERE_DOC;
+            r->append = false;
+        } else if (!strcmp(op, ">") || !strcmp(op, ">>")) {
+            r->rw = WRITE;
+            r->append = (op[1] == '>');
+        } else {
+            continue;
+        }
+        r->file = tlist.head[++i].token;
+        st.redir_ct++;
+    }
+
+    int in_fd = -1, out_fd = -1;
+    bool opened = open_redirects(&st, &in_fd, &out_fd);
+    free(redirs);
+    if (!opened) {
+        if (in_fd >= 0) {
+            close(in_fd);
+        }
+        if (out_fd >= 0) {
+            close(out_fd);
+        }
+        return true; // error
+    }
+    fflush(stdout);
+    int saved_in = (in_fd >= 0) ? move_fd(in_fd, STDIN_FILENO) : -1;
+    int saved_out = (out_fd >= 0) ? move_fd(out_fd, STDOUT_FILENO) : -1;
+    tlist.count = argc;
+    bool failed = b->run(tlist);
+    fflush(stdout);
+    if (in_fd >= 0) {
+        restore_fd(saved_in, STDIN_FILENO);
+    }
+    if (out_fd >= 0) {
+        restore_fd(saved_out, STDOUT_FILENO);
+    }
+    return failed;
+}
+
+/**
+ * puts fd on target and returns a close-on-exec copy of what target
+ * was, or -1 if it was closed
+ */
+static int move_fd (int fd, int target)
+{
+    int saved = fcntl(target, F_DUPFD_CLOEXEC, 10);
+    if (dup2(fd, target) < 0) {
+        perror("dup2 failed in run_redirected");
+    }
+    close(fd);
+    return saved;
+}
+
+/**
+ * puts back what move_fd saved from target
+ */
+static void restore_fd (int saved, int target)
+{
+    if (saved < 0) {
+        close(target);
+        return;
+    }
+    dup2(saved, target);
+    close(saved);
+}
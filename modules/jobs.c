@@ -0,0 +1,337 @@
+/************************************************
+ *                   jobs.c                     *
+ ************************************************
+ * jobs keeps the table of background and       *
+ * stopped pipelines. SIGCHLD is blocked and    *
+ * read from a signalfd, so children are reaped *
+ * when the main loop sees it is readable       *
+ * instead of from a signal handler             *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/jobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+
+static void reap_job (job *);
+static void drain ();
+
+static job *first = NULL; // in order of id
+static job *last = NULL;
+static int sig_fd = -1;
+static sigset_t child_mask; // signal mask to hand to children
+static bool notices = false; // print when jobs finish
+
+/**
+ * blocks SIGCHLD and opens the signalfd it is read from. Finished
+ * jobs are only announced by interactive shells
+ */
+void jobs_init (bool interactive)
+{
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &chld, &child_mask) < 0) {
+        perror("sigprocmask failed in jobs_init");
+        return;
+    }
+    sig_fd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sig_fd < 0) {
+        perror("signalfd failed in jobs_init");
+    }
+    notices = interactive;
+}
+
+/**
+ * the fd that becomes readable when a child changes state, -1 if
+ * there isn't one
+ */
+int jobs_fd ()
+{
+    return sig_fd;
+}
+
+/**
+ * the signal mask the shell had before SIGCHLD was blocked, which is
+ * what commands should start with
+ */
+const sigset_t *jobs_child_mask ()
+{
+    return &child_mask;
+}
+
+/**
+ * adds a pipeline to the table. pids, status and usage are copied,
+ * stages with a pid below 0 count as already reaped
+ */
+job *job_add (const pipeline *pl, pid_t pgid, const pid_t *pids,
+    const int *status, const cmd_usage *usage, int count)
+{
+    job *j = malloc(sizeof(job));
+    if (j == NULL) {
+        perror("malloc failed in job_add");
+        exit(-1);
+    }
+    j->pids = malloc(sizeof(pid_t) * count);
+    j->status = malloc(sizeof(int) * count);
+    j->usage = malloc(sizeof(cmd_usage) * count);
+    if (j->pids == NULL || j->status == NULL || j->usage == NULL) {
+        perror("malloc failed in job_add");
+        exit(-1);
+    }
+    memcpy(j->pids, pids, sizeof(pid_t) * count);
+    memcpy(j->status, status, sizeof(int) * count);
+    memcpy(j->usage, usage, sizeof(cmd_usage) * count);
+    j->count = count;
+    j->live = 0;
+    for (int i = 0; i < count; i++) {
+        if (pids[i] > 0) {
+            j->live++;
+        }
+    }
+    j->id = last ? last->id + 1 : 1;
+    j->pgid = pgid;
+    j->stopped = false;
+    j->cmd = pipeline_text(pl);
+    j->next = NULL;
+
+    if (last) {
+        last->next = j;
+    } else {
+        first = j;
+    }
+    last = j;
+    return j;
+}
+
+/**
+ * finds a job by id, or the newest job if id is 0. NULL if there is
+ * no such job
+ */
+job *job_find (int id)
+{
+    if (id == 0) {
+        return last;
+    }
+    for (job *j = first; j != NULL; j = j->next) {
+        if (j->id == id) {
+            return j;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * the oldest job, NULL if there are none. The rest follow it by next
+ */
+job *jobs_first ()
+{
+    return first;
+}
+
+/**
+ * takes a job out of the table and frees it. A finished job is counted
+ * in the session's accounting
+ */
+void job_remove (job *j)
+{
+    job **link = &first;
+    job *prev = NULL;
+    while (*link != NULL && *link != j) {
+        prev = *link;
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        return;
+    }
+    *link = j->next;
+    if (last == j) {
+        last = prev;
+    }
+    /* wait and fg reap with wait_stages, which doesn't keep live */
+    bool finished = true;
+    cmd_usage total = {0};
+    for (int i = 0; i < j->count; i++) {
+        finished &= j->pids[i] < 0;
+        acct_add(&total, &j->usage[i]);
+    }
+    if (finished) {
+        acct_record(&total, j->cmd);
+    }
+    free(j->pids);
+    free(j->status);
+    free(j->usage);
+    free(j->cmd);
+    free(j);
+}
+
+/**
+ * waits for every stage that hasn't been reaped yet, in order, saving
+ * its exit code and resource usage and setting its pid to -1. With
+ * untraced, returns true as soon as a stage stops so the caller can
+ * make it a job
+ */
+bool wait_stages (pid_t *pids, int *status, cmd_usage *usage, int count,
+    bool untraced)
+{
+    for (int i = 0; i < count; i++) {
+        if (pids[i] < 0) {
+            continue;
+        }
+        int st;
+        struct rusage ru;
+        while (wait4(pids[i], &st, untraced ? WUNTRACED : 0, &ru) < 0) {
+            if (errno != EINTR) {
+                perror("wait4 failed in wait_stages");
+                st = -1;
+                memset(&ru, 0, sizeof(ru));
+                break;
+            }
+        }
+        if (st >= 0 && WIFSTOPPED(st)) {
+            return true;
+        }
+        status[i] = status_code(st);
+        acct_reaped(&usage[i], &ru);
+        pids[i] = -1;
+    }
+    return false;
+}
+
+/**
+ * converts a wait status to a shell exit code, 128+n for signal n
+ */
+int status_code (int status)
+{
+    if (status < 0) {
+        return 127;
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return 0;
+}
+
+/**
+ * called when jobs_fd is readable. Empties it so it can be polled
+ * again, then reaps whatever finished
+ */
+void jobs_signalled ()
+{
+    drain();
+    jobs_update();
+}
+
+/**
+ * collects the state changes of every job's children without blocking.
+ * Costs nothing when there are no jobs
+ */
+void jobs_update ()
+{
+    job *j = first;
+    while (j != NULL) {
+        job *next = j->next;
+        reap_job(j);
+        if (j->live == 0 && !notices) { // nobody to tell
+            job_remove(j);
+        }
+        j = next;
+    }
+}
+
+/**
+ * prints a line for every job that finished since the last time and
+ * drops it from the table. Done before each prompt
+ */
+void jobs_notify ()
+{
+    job *j = first;
+    while (j != NULL) {
+        job *next = j->next;
+        if (j->live == 0) {
+            int code = j->status[j->count - 1];
+            if (code == 0) {
+                printf("[%d]   Done\t\t%s\n", j->id, j->cmd);
+            } else {
+                printf("[%d]   Exit %d\t\t%s\n", j->id, code, j->cmd);
+            }
+            job_remove(j);
+        }
+        j = next;
+    }
+}
+
+/**
+ * prints every job and its state. Finished ones are dropped after
+ * they are shown
+ */
+void jobs_print ()
+{
+    jobs_update();
+    job *j = first;
+    while (j != NULL) {
+        job *next = j->next;
+        char mark = (j == last) ? '+' : ' ';
+        if (j->live == 0) {
+            printf("[%d]%c  Done\t\t%s\n", j->id, mark, j->cmd);
+            job_remove(j);
+        } else if (j->stopped) {
+            printf("[%d]%c  Stopped\t\t%s\n", j->id, mark, j->cmd);
+        } else {
+            printf("[%d]%c  Running\t\t%s &\n", j->id, mark, j->cmd);
+        }
+        j = next;
+    }
+}
+
+/**
+ * reaps the stages of j that changed state, without blocking
+ */
+static void reap_job (job *j)
+{
+    for (int i = 0; i < j->count; i++) {
+        if (j->pids[i] < 0) {
+            continue;
+        }
+        int st;
+        struct rusage ru;
+        pid_t pid = wait4(j->pids[i], &st, WNOHANG | WUNTRACED | WCONTINUED,
+            &ru);
+        if (pid <= 0) {
+            continue;
+        }
+        if (WIFSTOPPED(st)) {
+            j->stopped = true;
+        } else if (WIFCONTINUED(st)) {
+            j->stopped = false;
+        } else {
+            j->status[i] = status_code(st);
+            acct_reaped(&j->usage[i], &ru);
+            j->pids[i] = -1;
+            j->live--;
+        }
+    }
+}
+
+/**
+ * reads every queued SIGCHLD off the signalfd
+ */
+static void drain ()
+{
+    struct signalfd_siginfo info[8];
+    if (sig_fd < 0) {
+        return;
+    }
+    while (read(sig_fd, info, sizeof(info)) > 0) {
+    }
+}
@@ -0,0 +1,166 @@
+/************************************************
+ *                linereader.c                  *
+ ************************************************
+ * linereader reads a file descriptor in large  *
+ * chunks into a growable buffer and hands out  *
+ * one complete line at a time, of any length   *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/linereader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#define READ_CHUNK 65536
+
+static bool fill (line_reader *);
+
+/**
+ * sets up a reader for fd. The fd is not closed by reader_free
+ */
+void reader_init (line_reader *r, int fd)
+{
+    r->fd = fd;
+    r->buf = NULL;
+    r->cap = 0;
+    r->start = 0;
+    r->scanned = 0;
+    r->end = 0;
+    r->eof = false;
+    r->wake_fd = -1;
+    r->on_wake = NULL;
+}
+
+/**
+ * makes the reader call on_wake whenever fd becomes readable while it
+ * is waiting for input, so other events are handled without a timer
+ */
+void reader_set_wake (line_reader *r, int fd, void (*on_wake)())
+{
+    r->wake_fd = fd;
+    r->on_wake = on_wake;
+}
+
+/**
+ * points line at the next line, including its \n, and returns its
+ * length. A last line without a \n gets one added. The line is not
+ * \0 terminated and is only good until the next call. Returns -1 at
+ * the end of input or on a read error
+ */
+ssize_t read_line (line_reader *r, char **line)
+{
+    for (;;) {
+        size_t unscanned = r->end - r->start - r->scanned;
+        char *nl = NULL;
+        if (unscanned > 0) {
+            nl = memchr(r->buf + r->start + r->scanned, '\n', unscanned);
+        }
+        if (nl != NULL) {
+            *line = r->buf + r->start;
+            size_t length = nl - *line + 1;
+            r->start += length;
+            r->scanned = 0;
+            return length;
+        }
+        r->scanned = r->end - r->start; // don't search these bytes again
+
+        if (r->eof) {
+            if (r->start == r->end) {
+                return -1;
+            }
+            /* fill always leaves room for this \n */
+            r->buf[r->end++] = '\n';
+            continue;
+        }
+        if (!fill(r)) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * read_line for code that takes any source of lines, with the reader
+ * passed as r
+ */
+ssize_t reader_next_line (void *r, char **line)
+{
+    return read_line(r, line);
+}
+
+/**
+ * frees the buffer
+ */
+void reader_free (line_reader *r)
+{
+    free(r->buf);
+    int wake_fd = r->wake_fd;
+    void (*on_wake)() = r->on_wake;
+    reader_init(r, r->fd);
+    reader_set_wake(r, wake_fd, on_wake);
+}
+
+/**
+ * reads more input after what is buffered, moving the unread part to
+ * the front and growing the buffer when it is full. Returns false on
+ * a read error
+ */
+static bool fill (line_reader *r)
+{
+    if (r->start > 0) { // drop lines already handed out
+        memmove(r->buf, r->buf + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+    }
+    /* keep one byte spare for a missing final \n */
+    if (r->cap - r->end < READ_CHUNK / 2 + 1) {
+        size_t cap = r->cap ? r->cap * 2 : READ_CHUNK;
+        char *buf = realloc(r->buf, cap);
+        if (buf == NULL) {
+            perror("realloc failed in read_line");
+            exit(-1);
+        }
+        r->buf = buf;
+        r->cap = cap;
+    }
+
+    /* sleep until there is input, handling wakeups meanwhile */
+    while (r->wake_fd >= 0) {
+        struct pollfd fds[2] = {
+            {.fd = r->fd, .events = POLLIN},
+            {.fd = r->wake_fd, .events = POLLIN}
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll failed in read_line");
+            return false;
+        }
+        if (fds[1].revents & POLLIN) {
+            r->on_wake();
+        }
+        if (fds[0].revents) {
+            break;
+        }
+    }
+
+    ssize_t n;
+    do {
+        n = read(r->fd, r->buf + r->end, r->cap - r->end - 1);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        perror("read failed in read_line");
+        return false;
+    }
+    if (n == 0) {
+        r->eof = true;
+    }
+    r->end += n;
+    return true;
+}
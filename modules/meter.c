@@ -0,0 +1,238 @@
+/************************************************
+ *                   meter.c                    *
+ ************************************************
+ * meter relays each pipe of a pipeline through *
+ * a process that splices it along, counting    *
+ * the bytes and how long the pipe sat empty    *
+ * or full, to show which stage holds it up     *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#define _GNU_SOURCE
+
+#include "../includes/meter.h"
+#include "../includes/accounting.h"
+#include "../includes/jobs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+#define SPLICE_CHUNK (1 << 20)
+
+static void relay (pipe_meter *, int (*)[2], int (*)[2], int);
+static void close_link (pipe_meter *, int (*)[2], int (*)[2], int);
+static void close_other_fds (int (*)[2], int (*)[2], int, int);
+
+/**
+ * starts a relay in process group pgid that splices from[i][0] into
+ * to[i][1] for each of count pipes, keeping count in shared memory.
+ * The caller closes its copies of those ends afterwards. Returns false
+ * if it couldn't be started
+ */
+bool meter_start (meter *m, int (*from)[2], int (*to)[2], int count,
+    pid_t pgid)
+{
+    m->count = count;
+    m->links = mmap(NULL, sizeof(pipe_meter) * count, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (m->links == MAP_FAILED) {
+        perror("mmap failed in meter_start");
+        return false;
+    }
+    memset(m->links, 0, sizeof(pipe_meter) * count);
+
+    int done[2];
+    if (pipe2(done, O_CLOEXEC) < 0) {
+        perror("pipe failed in meter_start");
+        munmap(m->links, sizeof(pipe_meter) * count);
+        return false;
+    }
+
+    /* the relay's parent exits right away, so the relay is never the
+     * shell's child and needs no reaping, even if the pipeline becomes
+     * a job and outlives this */
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed in meter_start");
+        close(done[0]);
+        close(done[1]);
+        munmap(m->links, sizeof(pipe_meter) * count);
+        return false;
+    } else if (pid == 0) {
+        if (fork() == 0) {
+            setpgid(0, pgid);
+            close_other_fds(from, to, count, done[1]);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTTOU, SIG_DFL);
+            signal(SIGTSTP, SIG_DFL);
+            signal(SIGTTIN, SIG_DFL);
+            signal(SIGPIPE, SIG_IGN); // a reader leaving only ends its pipe
+            sigprocmask(SIG_SETMASK, jobs_child_mask(), NULL);
+            relay(m->links, from, to, count);
+        }
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+    close(done[1]);
+    m->done_fd = done[0];
+    return true;
+}
+
+/**
+ * waits for the relay to finish and prints what went through each pipe
+ * of pl to stderr. Without report, as when the pipeline was stopped and
+ * became a job, the relay is left to carry on by itself
+ */
+void meter_finish (meter *m, const pipeline *pl, bool report)
+{
+    if (report) {
+        char c;
+        while (read(m->done_fd, &c, 1) < 0 && errno == EINTR) {
+            continue;
+        }
+        fprintf(stderr, "%-24s %12s %10s %16s %16s\n", "pipe", "bytes",
+            "MB/s", "empty (stalls)", "full (stalls)");
+        for (int i = 0; i < m->count; i++) {
+            const pipe_meter *p = &m->links[i];
+            char name[64];
+            snprintf(name, sizeof(name), "%d %s | %s", i + 1,
+                pl->stages[i].argc ? pl->stages[i].argv[0] : "",
+                pl->stages[i + 1].argc ? pl->stages[i + 1].argv[0] : "");
+            double span = p->end - p->start;
+            fprintf(stderr, "%-24.24s %12llu %10.1f %9.3fs %6ld %9.3fs %6ld\n",
+                name, p->bytes, span > 0 ? p->bytes / span / 1e6 : 0.0,
+                p->in_wait, p->in_stalls, p->out_wait, p->out_stalls);
+        }
+    }
+    close(m->done_fd);
+    munmap(m->links, sizeof(pipe_meter) * m->count);
+}
+
+/**
+ * moves data along every pipe until all of them are closed. A pipe
+ * waits for its writer until it has data, then is spliced until the
+ * writer's pipe is empty or the reader's is full, which are timed as
+ * in_wait and out_wait
+ */
+static void relay (pipe_meter *links, int (*from)[2], int (*to)[2], int count)
+{
+    struct pollfd fds[count];
+    bool want_out[count]; // waiting for room to write, else for data
+    int open_ct = count;
+    double now = acct_now();
+    for (int i = 0; i < count; i++) {
+        links[i].start = now;
+        want_out[i] = false;
+    }
+
+    while (open_ct > 0) {
+        for (int i = 0; i < count; i++) {
+            if (from[i][0] < 0) {
+                fds[i].fd = -1;
+            } else if (want_out[i]) {
+                fds[i].fd = to[i][1];
+                fds[i].events = POLLOUT;
+            } else {
+                fds[i].fd = from[i][0];
+                fds[i].events = POLLIN;
+            }
+        }
+        double before = acct_now();
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        double waited = acct_now() - before;
+
+        for (int i = 0; i < count; i++) {
+            if (from[i][0] < 0) {
+                continue;
+            }
+            if (want_out[i]) {
+                links[i].out_wait += waited;
+            } else {
+                links[i].in_wait += waited;
+            }
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            while (true) {
+                ssize_t n = splice(from[i][0], NULL, to[i][1], NULL,
+                    SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n > 0) {
+                    links[i].bytes += n;
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0 && errno == EAGAIN) {
+                    /* data left means the reader's pipe is full */
+                    int left = 0;
+                    ioctl(from[i][0], FIONREAD, &left);
+                    want_out[i] = left > 0;
+                    if (want_out[i]) {
+                        links[i].out_stalls++;
+                    } else {
+                        links[i].in_stalls++;
+                    }
+                    break;
+                }
+                close_link(links, from, to, i); // EOF, or the reader left
+                open_ct--;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * closes both ends the relay holds for pipe i and stamps its end time
+ */
+static void close_link (pipe_meter *links, int (*from)[2], int (*to)[2],
+    int i)
+{
+    close(from[i][0]);
+    close(to[i][1]);
+    from[i][0] = -1;
+    links[i].end = acct_now();
+}
+
+/**
+ * closes every fd the relay got from the shell but the ends it moves
+ * data between, keep and stdio. It never execs, so close-on-exec fds
+ * would stay open, and a write end of some other pipe held here would
+ * keep that pipe's reader from seeing EOF
+ */
+static void close_other_fds (int (*from)[2], int (*to)[2], int count,
+    int keep)
+{
+    DIR *dp = opendir("/proc/self/fd");
+    if (dp == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        int fd = atoi(entry->d_name);
+        bool used = fd <= STDERR_FILENO || fd == dirfd(dp) || fd == keep;
+        for (int i = 0; i < count && !used; i++) {
+            used = (fd == from[i][0] || fd == to[i][1]);
+        }
+        if (!used) {
+            close(fd);
+        }
+    }
+    closedir(dp);
+}
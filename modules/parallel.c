@@ -0,0 +1,283 @@
+/************************************************
+ *                 parallel.c                   *
+ ************************************************
+ * parallel runs one command per argument with  *
+ * up to N of them at a time. Each command's    *
+ * stdout goes to its own pipe and is buffered  *
+ * so outputs come out whole, never interleaved *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#define _GNU_SOURCE
+
+#include "../includes/parallel.h"
+#include "../includes/executor.h"
+#include "../includes/jobs.h"
+#include "../includes/accounting.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#define READ_CHUNK 65536
+
+typedef struct {
+    stage st; // the command run for this input
+    cmd_usage usage;
+    pid_t pid; // -1 once reaped or if it never started
+    int out_fd; // read end of its stdout, -1 at EOF
+    char *buf; // everything it wrote
+    size_t len;
+    size_t cap;
+    int status;
+    bool done;
+} par_job;
+
+static char *fill_in (const char *, const char *, arena *);
+static void start_job (par_job *, const stage *, const char *, int, arena *);
+static void read_output (par_job *);
+static void emit (par_job *);
+
+/**
+ * runs tmpl once for every arg with at most max_jobs running at once.
+ * Every {} in the argv and redirect files of tmpl is replaced by the
+ * arg, which is added to the end of argv if there is no {}. Output is
+ * printed in the order of args if keep_order, else as jobs finish.
+ * Scratch memory comes from mem. Returns how many jobs failed
+ */
+int run_parallel (const stage *tmpl, char **args, int arg_ct, int max_jobs,
+    bool keep_order, arena *mem)
+{
+    par_job *jobs = calloc(arg_ct, sizeof(par_job));
+    int *slots = malloc(sizeof(int) * max_jobs); // jobs in flight
+    struct pollfd *fds = malloc(sizeof(struct pollfd) * (max_jobs + 1));
+    int *fd_job = malloc(sizeof(int) * (max_jobs + 1));
+    if ((arg_ct && jobs == NULL) || slots == NULL || fds == NULL ||
+        fd_job == NULL) {
+        perror("malloc failed in run_parallel");
+        exit(-1);
+    }
+
+    /* jobs read nothing from the shell's stdin */
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    int sig_fd = jobs_fd();
+    int next = 0; // next arg to start
+    int printed = 0; // in order, every job before this one is printed
+    int failed = 0;
+    int running = 0;
+
+    while (next < arg_ct || running > 0) {
+        while (running < max_jobs && next < arg_ct) {
+            start_job(&jobs[next], tmpl, args[next], null_fd, mem);
+            if (!jobs[next].done) {
+                slots[running++] = next;
+            }
+            next++;
+        }
+
+        /* sleep until some output arrives or a child exits */
+        int nfds = 0;
+        for (int s = 0; s < running; s++) {
+            if (jobs[slots[s]].out_fd >= 0) {
+                fds[nfds].fd = jobs[slots[s]].out_fd;
+                fds[nfds].events = POLLIN;
+                fd_job[nfds++] = slots[s];
+            }
+        }
+        if (sig_fd >= 0) {
+            fds[nfds].fd = sig_fd;
+            fds[nfds].events = POLLIN;
+            fd_job[nfds++] = -1;
+        }
+        if (running > 0 && nfds > 0 && poll(fds, nfds, -1) < 0 &&
+            errno != EINTR) {
+            perror("poll failed in run_parallel");
+            break;
+        }
+        for (int f = 0; f < nfds; f++) {
+            if (fds[f].revents == 0) {
+                continue;
+            }
+            if (fd_job[f] < 0) {
+                jobs_signalled(); // empties the signalfd
+            } else {
+                read_output(&jobs[fd_job[f]]);
+            }
+        }
+
+        /* a job is finished once it has exited and closed its stdout */
+        for (int s = 0; s < running; s++) {
+            par_job *j = &jobs[slots[s]];
+            if (j->pid > 0) {
+                int st;
+                struct rusage ru;
+                /* without a signalfd nothing wakes us up, so block once
+                 * its output is over */
+                int opts = (sig_fd < 0 && j->out_fd < 0) ? 0 : WNOHANG;
+                if (wait4(j->pid, &st, opts, &ru) == j->pid) {
+                    j->status = status_code(st);
+                    acct_reaped(&j->usage, &ru);
+                    j->pid = -1;
+                    pipeline pl = {&j->st, 1, false};
+                    acct_record_pipeline(&j->usage, &pl);
+                }
+            }
+            if (j->pid < 0 && j->out_fd < 0) {
+                j->done = true;
+                if (!keep_order) {
+                    emit(j);
+                }
+                slots[s--] = slots[--running];
+            }
+        }
+
+        /* move past everything finished so far, printing it in order */
+        while (printed < next && jobs[printed].done) {
+            if (keep_order) {
+                emit(&jobs[printed]);
+            }
+            if (jobs[printed].status != 0) {
+                failed++;
+            }
+            printed++;
+        }
+    }
+
+    fflush(stdout);
+    if (null_fd >= 0) {
+        close(null_fd);
+    }
+    free(fd_job);
+    free(fds);
+    free(slots);
+    free(jobs);
+    return failed;
+}
+
+/**
+ * copies tok with every {} replaced by arg
+ */
+static char *fill_in (const char *tok, const char *arg, arena *mem)
+{
+    size_t arg_len = strlen(arg);
+    size_t len = strlen(tok);
+    for (const char *c = strstr(tok, "{}"); c; c = strstr(c + 2, "{}")) {
+        len += arg_len;
+    }
+
+    char *out = arena_alloc(mem, len + 1);
+    char *end = out;
+    const char *c;
+    while ((c = strstr(tok, "{}")) != NULL) {
+        memcpy(end, tok, c - tok);
+        end += c - tok;
+        memcpy(end, arg, arg_len);
+        end += arg_len;
+        tok = c + 2;
+    }
+    strcpy(end, tok);
+    return out;
+}
+
+/**
+ * builds the stage for arg and launches it with its stdout on a new
+ * pipe. A job that can't be started is marked done right away
+ */
+static void start_job (par_job *j, const stage *tmpl, const char *arg,
+    int in_fd, arena *mem)
+{
+    stage st;
+    bool placed = false;
+    acct_start(&j->usage);
+    st.argc = tmpl->argc;
+    st.argv = arena_alloc(mem, sizeof(char *) * (tmpl->argc + 2));
+    for (int i = 0; i < tmpl->argc; i++) {
+        placed |= strstr(tmpl->argv[i], "{}") != NULL;
+        st.argv[i] = fill_in(tmpl->argv[i], arg, mem);
+    }
+    st.redir_ct = tmpl->redir_ct;
+    st.redirs = arena_alloc(mem, sizeof(redirect) * (tmpl->redir_ct + 1));
+    for (int i = 0; i < tmpl->redir_ct; i++) {
+        st.redirs[i] = tmpl->redirs[i];
+        placed |= strstr(tmpl->redirs[i].file, "{}") != NULL;
+        st.redirs[i].file = fill_in(tmpl->redirs[i].file, arg, mem);
+    }
+    if (!placed) {
+        st.argv[st.argc++] = fill_in(arg, arg, mem);
+    }
+    st.argv[st.argc] = NULL;
+    st.batch = tmpl->batch;
+    st.batch_keep = tmpl->batch_keep;
+    st.batch_jobs = tmpl->batch_jobs;
+
+    j->pid = -1;
+    j->out_fd = -1;
+    j->status = 0;
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        perror("pipe failed in run_parallel");
+        j->status = 126;
+        j->done = true;
+        return;
+    }
+    j->st = st;
+    j->pid = launch_stage(&st, in_fd, pipefd[1], &j->status);
+    close(pipefd[1]);
+    if (j->pid < 0) {
+        close(pipefd[0]);
+        j->done = true;
+        return;
+    }
+    j->out_fd = pipefd[0];
+}
+
+/**
+ * reads what is waiting on a job's stdout into its buffer, closing it
+ * at EOF
+ */
+static void read_output (par_job *j)
+{
+    if (j->cap - j->len < READ_CHUNK) {
+        size_t cap = j->cap ? j->cap * 2 : READ_CHUNK;
+        while (cap - j->len < READ_CHUNK) {
+            cap *= 2;
+        }
+        char *buf = realloc(j->buf, cap);
+        if (buf == NULL) {
+            perror("realloc failed in run_parallel");
+            exit(-1);
+        }
+        j->buf = buf;
+        j->cap = cap;
+    }
+    ssize_t n = read(j->out_fd, j->buf + j->len, j->cap - j->len);
+    if (n < 0 && errno == EINTR) {
+        return;
+    }
+    if (n <= 0) {
+        close(j->out_fd);
+        j->out_fd = -1;
+        return;
+    }
+    j->len += n;
+}
+
+/**
+ * prints a finished job's output in one piece and frees it
+ */
+static void emit (par_job *j)
+{
+    if (j->len > 0) {
+        fwrite(j->buf, 1, j->len, stdout);
+    }
+    free(j->buf);
+    j->buf = NULL;
+    j->len = 0;
+    j->cap = 0;
+}
@@ -0,0 +1,405 @@
+/************************************************
+ *                 pathcache.c                  *
+ ************************************************
+ * pathcache keeps a hash table of executable   *
+ * names found in $PATH mapped to their full    *
+ * paths so commands don't rescan every PATH    *
+ * directory each time they are run             *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/pathcache.h"
+#include "../includes/trace.h"
+#include "../includes/vars.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define INIT_TABLE_SIZE 1024
+
+typedef struct hash_node {
+    char *name;
+    char *path;
+    unsigned int hits;
+    bool remembered; // shown by the hash builtin
+    bool manual; // added with hash -p, survives rescans
+    struct hash_node *next;
+} hash_node;
+
+typedef struct {
+    char *dir;
+    bool exists;
+    struct timespec mtime;
+} dir_stamp;
+
+static hash_node **table = NULL;
+static size_t table_size = 0;
+static size_t entry_ct = 0;
+
+static dir_stamp *dirs = NULL; // PATH directories the table was built from
+static int dir_ct = 0;
+static char *built_path = NULL; // copy of $PATH at the last rebuild
+static bool valid = false;
+
+static unsigned long hash_str (const char *);
+static hash_node* find_node (const char *);
+static hash_node* insert_node (const char *, const char *, bool);
+static void grow_table ();
+static void drop_nodes (bool);
+static void free_dirs ();
+static void scan_dir (const char *);
+static void rebuild ();
+static bool is_stale ();
+
+/**
+ * returns the full path of the executable name in $PATH, or NULL
+ * if it can't be found. The returned string belongs to the cache and
+ * is only good until the next lookup
+ */
+const char *path_lookup (const char *name)
+{
+    if (is_stale()) {
+        rebuild();
+    }
+    hash_node *node = find_node(name);
+    if (node == NULL) {
+        trace_count(CNT_PATH_MISSES);
+        return NULL;
+    }
+    trace_count(CNT_PATH_HITS);
+    node->hits++;
+    node->remembered = true;
+    return node->path;
+}
+
+/**
+ * adds name -> path to the table. Entries added this way are kept
+ * until the table is cleared, even if $PATH changes
+ */
+bool path_cache_add (const char *path, const char *name)
+{
+    if (table == NULL) {
+        grow_table();
+    }
+    hash_node *node = insert_node(name, path, true);
+    node->manual = true;
+    node->remembered = true;
+    return true;
+}
+
+/**
+ * looks up name in $PATH and marks it as remembered without counting
+ * a hit. Returns false if name isn't in $PATH
+ */
+bool path_cache_remember (const char *name)
+{
+    if (is_stale()) {
+        rebuild();
+    }
+    hash_node *node = find_node(name);
+    if (node == NULL) {
+        return false;
+    }
+    node->remembered = true;
+    return true;
+}
+
+/**
+ * forgets every entry, including ones added by hand
+ */
+void path_cache_clear ()
+{
+    drop_nodes(true);
+    valid = false;
+}
+
+/**
+ * forces the next lookup to rescan $PATH
+ */
+void path_cache_invalidate ()
+{
+    valid = false;
+}
+
+/**
+ * prints the remembered entries and how often each was used
+ */
+void path_cache_print ()
+{
+    bool header = false;
+    for (size_t i = 0; i < table_size; i++) {
+        for (hash_node *node = table[i]; node != NULL; node = node->next) {
+            if (!node->remembered) {
+                continue;
+            }
+            if (!header) {
+                printf("hits\tcommand\n");
+                header = true;
+            }
+            printf("%4u\t%s\n", node->hits, node->path);
+        }
+    }
+    if (!header) {
+        printf("hash: hash table empty\n");
+    }
+}
+
+/**
+ * FNV-1a hash of a string
+ */
+static unsigned long hash_str (const char *s)
+{
+    unsigned long h = 14695981039346656037UL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+/**
+ * finds the node for name, NULL if there isn't one
+ */
+static hash_node* find_node (const char *name)
+{
+    if (table == NULL) {
+        return NULL;
+    }
+    hash_node *node = table[hash_str(name) & (table_size - 1)];
+    while (node != NULL && strcmp(node->name, name)) {
+        node = node->next;
+    }
+    return node;
+}
+
+/**
+ * inserts name -> path. An existing entry is only overwritten when
+ * replace is true, so earlier PATH directories take precedence
+ */
+static hash_node* insert_node (const char *name, const char *path, bool replace)
+{
+    hash_node *node = find_node(name);
+    if (node != NULL) {
+        if (replace) {
+            char *tmp = strdup(path);
+            if (tmp == NULL) {
+                perror("malloc failed in insert_node");
+                exit(-1);
+            }
+            free(node->path);
+            node->path = tmp;
+        }
+        return node;
+    }
+
+    if (entry_ct >= table_size) {
+        grow_table();
+    }
+    node = malloc(sizeof(hash_node));
+    if (node == NULL) {
+        perror("malloc failed in insert_node");
+        exit(-1);
+    }
+    node->name = strdup(name);
+    node->path = strdup(path);
+    if (node->name == NULL || node->path == NULL) {
+        perror("malloc failed in insert_node");
+        exit(-1);
+    }
+    node->hits = 0;
+    node->remembered = false;
+    node->manual = false;
+
+    unsigned long slot = hash_str(name) & (table_size - 1);
+    node->next = table[slot];
+    table[slot] = node;
+    entry_ct++;
+    return node;
+}
+
+/**
+ * doubles the number of buckets and rehashes every node
+ */
+static void grow_table ()
+{
+    size_t new_size = table_size ? table_size * 2 : INIT_TABLE_SIZE;
+    hash_node **new_table = calloc(new_size, sizeof(hash_node *));
+    if (new_table == NULL) {
+        perror("malloc failed in grow_table");
+        exit(-1);
+    }
+    for (size_t i = 0; i < table_size; i++) {
+        hash_node *node = table[i];
+        while (node != NULL) {
+            hash_node *next = node->next;
+            unsigned long slot = hash_str(node->name) & (new_size - 1);
+            node->next = new_table[slot];
+            new_table[slot] = node;
+            node = next;
+        }
+    }
+    free(table);
+    table = new_table;
+    table_size = new_size;
+}
+
+/**
+ * frees the nodes found by scanning PATH, and the manual ones too
+ * if all is true
+ */
+static void drop_nodes (bool all)
+{
+    for (size_t i = 0; i < table_size; i++) {
+        hash_node **link = &table[i];
+        while (*link != NULL) {
+            hash_node *node = *link;
+            if (node->manual && !all) {
+                link = &node->next;
+                continue;
+            }
+            *link = node->next;
+            free(node->name);
+            free(node->path);
+            free(node);
+            entry_ct--;
+        }
+    }
+}
+
+/**
+ * frees the saved PATH directory stamps
+ */
+static void free_dirs ()
+{
+    for (int i = 0; i < dir_ct; i++) {
+        free(dirs[i].dir);
+    }
+    free(dirs);
+    dirs = NULL;
+    dir_ct = 0;
+    free(built_path);
+    built_path = NULL;
+}
+
+/**
+ * adds every entry of dir that is a file we can execute to the table,
+ * so a later directory in $PATH can still supply the name
+ */
+static void scan_dir (const char *dir)
+{
+    DIR *dp = opendir(dir);
+    if (dp == NULL) {
+        return;
+    }
+    trace_count(CNT_DIR_SCANS);
+    int fd = dirfd(dp);
+    int dirlen = strlen(dir);
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_type != DT_REG) {
+            /* links and unknown types are whatever they lead to */
+            struct stat st;
+            if ((entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) ||
+                fstatat(fd, entry->d_name, &st, 0) < 0 ||
+                !S_ISREG(st.st_mode)) {
+                continue;
+            }
+        }
+        if (faccessat(fd, entry->d_name, X_OK, AT_EACCESS) < 0) {
+            continue;
+        }
+        char full[dirlen + strlen(entry->d_name) + 2];
+        sprintf(full, "%s/%s", dir, entry->d_name);
+        insert_node(entry->d_name, full, false);
+    }
+    closedir(dp);
+}
+
+/**
+ * throws away everything found in the last scan and rescans
+ * every directory in $PATH, saving their mtimes
+ */
+static void rebuild ()
+{
+    drop_nodes(false);
+    free_dirs();
+    if (table == NULL) {
+        grow_table();
+    }
+
+    const char *fpath = var_get("PATH");
+    if (fpath == NULL) {
+        fpath = "";
+    }
+    built_path = strdup(fpath);
+    if (built_path == NULL) {
+        perror("malloc failed in rebuild");
+        exit(-1);
+    }
+
+    /* one stamp per colon separated directory, empty means cwd */
+    int count = 1;
+    for (const char *c = fpath; *c; c++) {
+        if (*c == ':') {
+            count++;
+        }
+    }
+    dirs = calloc(count, sizeof(dir_stamp));
+    if (dirs == NULL) {
+        perror("malloc failed in rebuild");
+        exit(-1);
+    }
+
+    const char *start = fpath;
+    for (int i = 0; i < count && *fpath; i++) {
+        const char *end = strchr(start, ':');
+        int length = end ? end - start : (int)strlen(start);
+        dirs[i].dir = length ? strndup(start, length) : strdup(".");
+        if (dirs[i].dir == NULL) {
+            perror("malloc failed in rebuild");
+            exit(-1);
+        }
+        struct stat st;
+        if (stat(dirs[i].dir, &st) == 0) {
+            dirs[i].exists = true;
+            dirs[i].mtime = st.st_mtim;
+            scan_dir(dirs[i].dir);
+        }
+        dir_ct++;
+        start = end ? end + 1 : start + length;
+    }
+    valid = true;
+}
+
+/**
+ * the table is stale if it was invalidated, $PATH changed, or one of
+ * the PATH directories was modified since it was scanned
+ */
+static bool is_stale ()
+{
+    if (!valid) {
+        return true;
+    }
+    const char *fpath = var_get("PATH");
+    if (strcmp(fpath ? fpath : "", built_path)) {
+        return true;
+    }
+    struct stat st;
+    for (int i = 0; i < dir_ct; i++) {
+        bool exists = stat(dirs[i].dir, &st) == 0;
+        if (exists != dirs[i].exists) {
+            return true;
+        }
+        if (exists && (st.st_mtim.tv_sec != dirs[i].mtime.tv_sec ||
+                       st.st_mtim.tv_nsec != dirs[i].mtime.tv_nsec)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,218 @@
+/************************************************
+ *                  pipeline.c                  *
+ ************************************************
+ * pipeline splits a list of tokens at its      *
+ * pipes into stages, each with the argv to     *
+ * exec and the redirects to apply              *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void build_stage (ListHandler, stage *);
+static ListHandler get_next_subsection (ListHandler, int);
+static int count_pipes (ListHandler);
+
+/**
+ * Splits the tokens into one stage per command between pipes.
+ * Everything is allocated in the token list's arena and points at
+ * the token strings
+ */
+void build_pipeline (ListHandler tlist, pipeline *pl)
+{
+    pl->pipe_size = 0;
+    pl->meter = false;
+    pl->here_docs = 0;
+    pl->substs = 0;
+    pl->expands = 0;
+    for (int i = 0; i < tlist.count; i++) {
+        pl->substs += is_proc_subst(&tlist.head[i]);
+        pl->expands += !tlist.head[i].special &&
+            strpbrk(tlist.head[i].token, MARKS) != NULL;
+    }
+
+    /* a trailing & only says how to run it, it isn't part of a stage */
+    pl->background = false;
+    if (tlist.count > 0 && tlist.head[tlist.count-1].special &&
+        !strcmp(tlist.head[tlist.count-1].token, "&")) {
+        pl->background = true;
+        tlist.count--;
+    }
+
+    /* find number of pipes in the tokens */
+    pl->count = count_pipes(tlist) + 1;
+    pl->stages = arena_alloc(tlist.mem, sizeof(stage) * pl->count);
+
+    /* split input into separate cmds if pipe(s) */
+    int start = 0;
+    for (int i = 0; i < pl->count; i++) {
+        ListHandler cmd = get_next_subsection(tlist, start);
+        build_stage(cmd, &pl->stages[i]);
+        for (int r = 0; r < pl->stages[i].redir_ct; r++) {
+            pl->here_docs += (pl->stages[i].redirs[r].rw == HERE_DOC);
+        }
+        start += cmd.count + 1; // move to next non pipe token
+    }
+}
+
+/**
+ * rebuilds the command line of a pipeline for printing. The string is
+ * malloced and belongs to the caller
+ */
+char *pipeline_text (const pipeline *pl)
+{
+    size_t len = 1;
+    for (int i = 0; i < pl->count; i++) {
+        const stage *st = &pl->stages[i];
+        for (int a = 0; a < st->argc; a++) {
+            len += strlen(st->argv[a]) + 1;
+        }
+        for (int r = 0; r < st->redir_ct; r++) {
+            len += strlen(st->redirs[r].file) + 5;
+        }
+        len += 2; // "| "
+    }
+
+    char *text = malloc(len);
+    if (text == NULL) {
+        perror("malloc failed in pipeline_text");
+        exit(-1);
+    }
+    char *end = text;
+    for (int i = 0; i < pl->count; i++) {
+        const stage *st = &pl->stages[i];
+        if (i > 0) {
+            end += sprintf(end, "| ");
+        }
+        for (int a = 0; a < st->argc; a++) {
+            end += sprintf(end, "%s ", st->argv[a]);
+        }
+        for (int r = 0; r < st->redir_ct; r++) {
+            const redirect *rd = &st->redirs[r];
+            if (rd->rw == HERE_DOC) { // bodies are too long to show
+                end += sprintf(end, "<< ... ");
+                continue;
+            }
+            const char *op = (rd->rw == READ) ? "<" :
+                (rd->rw == HERE_STRING) ? "<<<" : rd->append ? ">>" : ">";
+            end += sprintf(end, "%s %s ", op, rd->file);
+        }
+    }
+    if (end > text) {
+        end--; // trailing space
+    }
+    *end = '\0';
+    return text;
+}
+
+/**
+ * true if a token is a <(cmd) or >(cmd), which is an arg like any
+ * other once it has been swapped for the path of its pipe
+ */
+bool is_proc_subst (const tok_node *t)
+{
+    return t->special && (t->token[0] == '<' || t->token[0] == '>') &&
+        t->token[1] == '(';
+}
+
+/**
+ * Takes a single command and splits it into the argv to exec and the
+ * redirects to apply. argv is the slice of tokens before the first
+ * redirect. Everything is allocated in the line's arena
+ */
+static void build_stage (ListHandler cmd_list, stage *st)
+{
+    /* room for each token plus a NULL */
+    st->argv = arena_alloc(cmd_list.mem, sizeof(char *) * (cmd_list.count + 1));
+    st->redirs = arena_alloc(cmd_list.mem, sizeof(redirect) * cmd_list.count);
+    st->redir_ct = 0;
+    st->batch = false;
+    st->batch_keep = 0;
+    st->batch_jobs = 0;
+
+    /* build command. stop at first redirect or end */
+    int i = 0;
+    while (i < cmd_list.count && (!cmd_list.head[i].special ||
+        is_proc_subst(&cmd_list.head[i]))) {
+        st->argv[i] = cmd_list.head[i].token;
+        i++;
+    }
+    st->argc = i;
+    st->argv[i] = NULL; // end of cmd must be NULL for exec
+
+    for (; i < cmd_list.count; i++) {
+        tok_node *curr = &cmd_list.head[i];
+        if (curr->special) {
+            redirect *r = &st->redirs[st->redir_ct];
+            if (!strcmp(curr->token, ">")) {
+                /* next token should be output file, append false */
+                r->rw = WRITE;
+                r->append = false;
+            } else if (!strcmp(curr->token, ">>")) {
+                /* next token should be output file, append true */
+                r->rw = WRITE;
+                r->append = true;
+            } else if (!strcmp(curr->token, "<")) {
+                /* next token should be input to current cmd */
+                r->rw = READ;
+                r->append = false;
+            } else if (!strcmp(curr->token, "<<")) {
+                /* next token ends the here document's body */
+                r->rw = HERE_DOC;
+                r->append = false;
+            } else if (!strcmp(curr->token, "<<<")) {
+                /* next token is the input itself */
+                r->rw = HERE_STRING;
+                r->append = false;
+            } else {
+                continue;
+            }
+            r->file = cmd_list.head[++i].token;
+            st->redir_ct++;
+        }
+    }
+}
+
+/**
+ * Gets the next cmd subsection of the tokens starting at index start,
+ * ending when it reaches the end or it finds a |
+ */
+static ListHandler get_next_subsection (ListHandler tlist, int start)
+{
+    ListHandler cmd = tlist;
+    cmd.head = tlist.head + start; // head assumed to be the start token
+    cmd.cap = 0; // a slice, never appended to
+
+    int count = 0;
+    while (start + count < tlist.count) {
+        tok_node *curr = &cmd.head[count];
+        if (curr->special && !strcmp(curr->token, "|")) { // if pipe found
+            break;
+        }
+        count++;
+    }
+    cmd.count = count;
+
+    return cmd;
+}
+
+/**
+ * count total pipes in a given token list
+ */
+static int count_pipes (ListHandler tlist)
+{
+    int pipe_ct = 0;
+    for (int i = 0; i < tlist.count; i++) {
+        if (tlist.head[i].special) {
+            if (!strcmp(tlist.head[i].token, "|")) {
+                pipe_ct++;
+            }
+        }
+    }
+    return pipe_ct;
+}
@@ -0,0 +1,225 @@
+/************************************************
+ *                  procsub.c                   *
+ ************************************************
+ * procsub runs the commands of <(cmd) and      *
+ * >(cmd) in subshells connected to pipes, and  *
+ * keeps the shell's ends of those pipes until  *
+ * the line using them is done                  *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#define _GNU_SOURCE
+
+#include "../includes/procsub.h"
+#include "../includes/dispatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#define MAX_OPEN 64
+
+typedef struct {
+    int fd; // the shell's end, named by /dev/fd/fd
+    pid_t pid;
+    bool writes; // >(cmd), the shell's end is the write end
+} subst;
+
+/* substitutions of the line being run */
+static subst open_subs[MAX_OPEN];
+static int open_ct = 0;
+
+/* subshells not reaped yet, from <(cmd)s whose reader stopped early or
+ * from lines run in the background */
+static pid_t *leftover = NULL;
+static int leftover_ct = 0;
+static int leftover_cap = 0;
+
+static void run_subshell (const char *, size_t, int, int, bool);
+static void add_leftover (pid_t);
+
+/**
+ * runs cmd, len bytes without a \n, in a subshell with a pipe on its
+ * stdout, or its stdin if writes. Returns the shell's end of the pipe,
+ * close-on-exec so only the command naming it inherits it, or -1 if
+ * the subshell couldn't be started
+ */
+int procsub_open (const char *cmd, size_t len, bool writes)
+{
+    if (open_ct == MAX_OPEN) {
+        fprintf(stderr, "too many process substitutions\n");
+        return -1;
+    }
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        perror("pipe failed for process substitution");
+        return -1;
+    }
+    int mine = writes ? fds[1] : fds[0];
+    int theirs = writes ? fds[0] : fds[1];
+
+    pid_t pid = subshell(cmd, len, theirs, writes ? STDIN_FILENO :
+        STDOUT_FILENO, true);
+    close(theirs);
+    if (pid < 0) {
+        close(mine);
+        return -1;
+    }
+
+    open_subs[open_ct].fd = mine;
+    open_subs[open_ct].pid = pid;
+    open_subs[open_ct].writes = writes;
+    open_ct++;
+    return mine;
+}
+
+/**
+ * forks a copy of the shell that runs cmd, len bytes without a \n, as
+ * a line of its own with fd on target, and exits. In its own process
+ * group if own_group. Returns its pid, or -1 if the fork failed
+ */
+pid_t subshell (const char *cmd, size_t len, int fd, int target,
+    bool own_group)
+{
+    fflush(NULL); // or the subshell writes out what's buffered too
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed for subshell");
+    } else if (pid == 0) { // child
+        run_subshell(cmd, len, fd, target, own_group);
+    }
+    return pid;
+}
+
+/**
+ * the number of substitutions open, to give procsub_close so a line
+ * run inside another one only closes its own
+ */
+int procsub_mark ()
+{
+    return open_ct;
+}
+
+/**
+ * lets the command about to be launched with argv inherit the pipes it
+ * names as /dev/fd/n, or makes them close-on-exec again once it has
+ * been. Every other command never sees them
+ */
+void procsub_inherit (char **argv, bool on)
+{
+    if (open_ct == 0) {
+        return;
+    }
+    for (int a = 0; argv[a] != NULL; a++) {
+        if (strncmp(argv[a], "/dev/fd/", 8)) {
+            continue;
+        }
+        int fd = atoi(argv[a] + 8);
+        for (int i = 0; i < open_ct; i++) {
+            if (open_subs[i].fd == fd) {
+                fcntl(fd, F_SETFD, on ? 0 : FD_CLOEXEC);
+            }
+        }
+    }
+}
+
+/**
+ * closes the shell's end of every pipe opened since mark, so >(cmd)s
+ * see EOF and <(cmd)s that are still writing get SIGPIPE. With wait the
+ * >(cmd)s are waited for, so their output is done before the next line
+ * runs. Anything not waited for is reaped later by procsub_reap
+ */
+void procsub_close (int mark, bool wait)
+{
+    for (int i = mark; i < open_ct; i++) {
+        close(open_subs[i].fd);
+    }
+    for (int i = mark; i < open_ct; i++) {
+        pid_t pid = open_subs[i].pid;
+        if (!wait || !open_subs[i].writes) {
+            add_leftover(pid);
+            continue;
+        }
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+    }
+    open_ct = mark;
+    procsub_reap();
+}
+
+/**
+ * reaps the subshells that have finished since, without blocking.
+ * Costs nothing when there are none
+ */
+void procsub_reap ()
+{
+    int kept = 0;
+    for (int i = 0; i < leftover_ct; i++) {
+        if (waitpid(leftover[i], NULL, WNOHANG) == 0) {
+            leftover[kept++] = leftover[i];
+        }
+    }
+    leftover_ct = kept;
+}
+
+/**
+ * the child side of subshell. Puts fd on target, drops the pipes of
+ * substitutions so their readers and writers see EOF when they should,
+ * and runs cmd like a line of its own. Never returns
+ */
+static void run_subshell (const char *cmd, size_t len, int fd, int target,
+    bool own_group)
+{
+    for (int i = 0; i < open_ct; i++) {
+        close(open_subs[i].fd);
+    }
+    open_ct = 0;
+    leftover_ct = 0; // the shell's children, not ours
+    if (dup2(fd, target) < 0) {
+        perror("dup2 failed for process substitution");
+        exit(126);
+    }
+    close(fd);
+
+    /* its own group, so it never takes the terminal from the line */
+    if (own_group) {
+        setpgid(0, 0);
+    }
+    signal(SIGINT, SIG_DFL);
+
+    char *line = malloc(len + 1);
+    if (line == NULL) {
+        perror("malloc failed in run_subshell");
+        exit(-1);
+    }
+    memcpy(line, cmd, len);
+    line[len] = '\n';
+    run_line(line, len + 1, NULL, NULL);
+    free(line);
+    fflush(NULL);
+    exit(last_status());
+}
+
+/**
+ * remembers a subshell to reap later
+ */
+static void add_leftover (pid_t pid)
+{
+    if (leftover_ct == leftover_cap) {
+        int cap = leftover_cap ? leftover_cap * 2 : 8;
+        pid_t *tmp = realloc(leftover, sizeof(pid_t) * cap);
+        if (tmp == NULL) {
+            perror("realloc failed in add_leftover");
+            exit(-1);
+        }
+        leftover = tmp;
+        leftover_cap = cap;
+    }
+    leftover[leftover_ct++] = pid;
+}
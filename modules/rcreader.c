@@ -12,30 +12,30 @@
 
 #include "../includes/rcreader.h"
 #include "../includes/mycli.h"
-#include "../includes/executor.h"
-#include "../includes/internal.h"
+#include "../includes/dispatch.h"
+#include "../includes/linereader.h"
+#include "../includes/vars.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <sys/resource.h>
 
 /**
- * Opens the user's home directory using the $HOME environment
+ * Opens the user's home directory using the $HOME shell
  *  variable and tries to find a .mycli file that is executable
  *  to parse it into shell commands
  */
 void read_myclirc ()
 {
-    ListHandler tlist;
-
     /* set path to home and .myclirc */
-    const char *home = getenv("HOME");
+    const char *home = var_get("HOME");
     // strcat cuts off \0 bit from *dest, need a temp
     int pathlen = strlen(home);
-    char tmpstr[pathlen+1];
+    char tmpstr[pathlen + sizeof("/.myclirc")];
     strcpy(tmpstr, home);
     // store full path to .myclirc
     const char *rcfile = strcat(tmpstr, "/.myclirc");
@@ -50,23 +50,21 @@ void read_myclirc ()
                 found = 1;
                 // open if executable
                 if (access(rcfile, X_OK) == 0) {
-                    char buf[BUFF_SIZE];
-                    FILE *fp = fopen(rcfile, "r");
-                    // read file until EOF is found (fgets() returns NULL)
-                    while ((fgets(buf, BUFF_SIZE, fp)) != NULL) {
-                        tokenize(&tlist, buf);
-                        if (tlist.head) {
-                            int ret = run_internal_cmd(tlist);
-                            if (ret < 0) {
-                                fprintf(stderr, "unable to run internal command\n");
-                            } else if (ret == 0) {
-                            } else {
-                                execute(tlist.head);
-                            }
-                        }
-                        free_tok_list(&tlist);
+                    int fd = open(rcfile, O_RDONLY | O_CLOEXEC);
+                    if (fd < 0) {
+                        perror("In read_myclirc() - could not open .myclirc ");
+                        break;
+                    }
+                    line_reader rc;
+                    reader_init(&rc, fd);
+                    char *line;
+                    ssize_t length;
+                    // read file until EOF is found (read_line() returns -1)
+                    while ((length = read_line(&rc, &line)) >= 0) {
+                        run_line(line, length, reader_next_line, &rc);
                     }
-                    fclose(fp); // close the file
+                    reader_free(&rc);
+                    close(fd); // close the file
                 } else {
                     perror("In read_myclirc() - .myclirc is not executable ");
                 }
@@ -0,0 +1,215 @@
+/************************************************
+ *                   scan.c                     *
+ ************************************************
+ * scan finds how many plain characters start a *
+ * string, i.e. where the tokenizer's state     *
+ * machine next has something to decide. Uses   *
+ * SSE2 or AVX2 when the cpu has them           *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/scan.h"
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+/* Delimiters are space and control chars (anything below 33),
+ * non-ASCII (128 and up), quotes, redirects, pipes, &, backslashes,
+ * the $ and ` that start substitutions and the *, ? and [ of patterns */
+#define IS_DELIM(c) ((unsigned char)(c) < 33 || (unsigned char)(c) > 127 || \
+    (c) == '"' || (c) == '\'' || (c) == '<' || (c) == '>' || \
+    (c) == '|' || (c) == '&' || (c) == '\\' || (c) == '$' || (c) == '`' || \
+    (c) == '*' || (c) == '?' || (c) == '[')
+
+static size_t scan_scalar (const char *, size_t);
+#ifdef SCAN_X86
+static size_t scan_sse2 (const char *, size_t);
+static size_t scan_avx2 (const char *, size_t);
+#endif
+static size_t scan_resolve (const char *, size_t);
+
+static bool delim_table[256];
+static bool table_ready = false;
+static size_t (*scan_impl)(const char *, size_t) = scan_resolve;
+
+/**
+ * returns how many chars at the start of s are plain, up to len
+ */
+size_t scan_plain (const char *s, size_t len)
+{
+    return scan_impl(s, len);
+}
+
+/**
+ * picks the implementation used by scan_plain. Asking for one the cpu
+ * can't run gives the best one it can. Returns the mode now in use
+ */
+scan_mode scan_set_mode (scan_mode mode)
+{
+    if (!table_ready) {
+        for (int c = 0; c < 256; c++) {
+            delim_table[c] = IS_DELIM((char)c);
+        }
+        table_ready = true;
+    }
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+    if (mode == SCAN_AUTO || (mode == SCAN_AVX2 && !avx2)) {
+        mode = avx2 ? SCAN_AVX2 : SCAN_SSE2;
+    }
+#else
+    mode = SCAN_SCALAR;
+#endif
+    switch (mode) {
+#ifdef SCAN_X86
+        case SCAN_SSE2:
+            scan_impl = scan_sse2;
+            break;
+        case SCAN_AVX2:
+            scan_impl = scan_avx2;
+            break;
+#endif
+        default:
+            scan_impl = scan_scalar;
+            mode = SCAN_SCALAR;
+            break;
+    }
+    return mode;
+}
+
+/**
+ * name of a mode for printing
+ */
+const char *scan_mode_name (scan_mode mode)
+{
+    switch (mode) {
+        case SCAN_SCALAR:
+            return "scalar";
+        case SCAN_SSE2:
+            return "sse2";
+        case SCAN_AVX2:
+            return "avx2";
+        default:
+            return "auto";
+    }
+}
+
+/**
+ * first call of scan_plain picks the best implementation
+ */
+static size_t scan_resolve (const char *s, size_t len)
+{
+    scan_set_mode(SCAN_AUTO);
+    return scan_impl(s, len);
+}
+
+/**
+ * one byte at a time through a lookup table
+ */
+static size_t scan_scalar (const char *s, size_t len)
+{
+    size_t i = 0;
+    while (i < len && !delim_table[(unsigned char)s[i]]) {
+        i++;
+    }
+    return i;
+}
+
+#ifdef SCAN_X86
+/**
+ * 16 bytes at a time. A signed compare against 33 catches both the
+ * control chars and the bytes with the high bit set
+ */
+static size_t scan_sse2 (const char *s, size_t len)
+{
+    const __m128i low = _mm_set1_epi8(33);
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i bar = _mm_set1_epi8('|');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i dollar = _mm_set1_epi8('$');
+    const __m128i btick = _mm_set1_epi8('`');
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i qmark = _mm_set1_epi8('?');
+    const __m128i bracket = _mm_set1_epi8('[');
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hit = _mm_cmplt_epi8(v, low);
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, dquote));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, squote));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, lt));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, gt));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, bar));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, amp));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, bslash));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, dollar));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, btick));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, star));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, qmark));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, bracket));
+        unsigned int mask = _mm_movemask_epi8(hit);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scan_scalar(s + i, len - i);
+}
+
+/**
+ * 32 bytes at a time, same tests as scan_sse2
+ */
+__attribute__((target("avx2")))
+static size_t scan_avx2 (const char *s, size_t len)
+{
+    const __m256i low = _mm256_set1_epi8(33);
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i squote = _mm256_set1_epi8('\'');
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i bar = _mm256_set1_epi8('|');
+    const __m256i amp = _mm256_set1_epi8('&');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i dollar = _mm256_set1_epi8('$');
+    const __m256i btick = _mm256_set1_epi8('`');
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i qmark = _mm256_set1_epi8('?');
+    const __m256i bracket = _mm256_set1_epi8('[');
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i hit = _mm256_cmpgt_epi8(low, v);
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, dquote));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, squote));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, lt));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, gt));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, bar));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, amp));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, bslash));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, dollar));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, btick));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, star));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, qmark));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, bracket));
+        unsigned int mask = _mm256_movemask_epi8(hit);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    /* scan_sse2 is legacy SSE code, which runs very slowly on some
+     * cpus while the upper halves of the ymm registers are dirty */
+    _mm256_zeroupper();
+    return i + scan_sse2(s + i, len - i);
+}
+#endif
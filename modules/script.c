@@ -0,0 +1,136 @@
+/************************************************
+ *                  script.c                    *
+ ************************************************
+ * script runs a file of commands without a     *
+ * prompt. The file is mapped into memory and   *
+ * each line is tokenized where it sits, so     *
+ * nothing is copied into a read buffer first   *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/script.h"
+#include "../includes/dispatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct {
+    char *next; // start of the line after the one being run
+    char *end;
+    char *map; // mapped from base in the file
+    off_t base;
+    int sync_fd; // kept at next's offset, or -1
+} script_pos;
+
+static ssize_t next_script_line (void *, char **);
+static void run_last_line (const char *, size_t);
+
+/**
+ * runs every line of fd from its current offset to the end. The
+ * mapping is private, so the \0s written by the tokenizer only copy
+ * the pages they touch and never reach the file. If fd is stdin, its
+ * offset is kept at the start of the next line so commands reading
+ * stdin see the rest of the script like they would with sh. Returns
+ * -1 if fd isn't a regular file that can be mapped, 0 otherwise
+ */
+int run_script (int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return -1;
+    }
+    off_t start = lseek(fd, 0, SEEK_CUR);
+    if (start < 0) {
+        return -1;
+    }
+    if (start >= st.st_size) {
+        return 0; // nothing left to run
+    }
+
+    /* mmap offsets have to be page aligned */
+    off_t base = start - start % sysconf(_SC_PAGESIZE);
+    size_t size = st.st_size - base;
+    char *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, base);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    bool sync = (fd == STDIN_FILENO);
+    script_pos pos = {map + (start - base), map + size, map, base,
+        sync ? fd : -1};
+    while (pos.next < pos.end) {
+        char *line = pos.next;
+        char *nl = memchr(line, '\n', pos.end - line);
+        if (nl == NULL) {
+            if (sync) {
+                lseek(fd, st.st_size, SEEK_SET);
+            }
+            run_last_line(line, pos.end - line);
+            break;
+        }
+
+        /* here documents move pos.next past their bodies */
+        pos.next = nl + 1;
+        if (!sync) {
+            run_line_in_place(line, nl + 1 - line, next_script_line, &pos);
+            continue;
+        }
+
+        lseek(fd, base + (pos.next - map), SEEK_SET);
+        run_line_in_place(line, nl + 1 - line, next_script_line, &pos);
+
+        /* pick up wherever a command that read stdin left off */
+        off_t now = lseek(fd, 0, SEEK_CUR);
+        if (now < base || now >= st.st_size) {
+            break;
+        }
+        pos.next = map + (now - base);
+    }
+
+    munmap(map, size);
+    return 0;
+}
+
+/**
+ * hands out the next line of the script for a here document and
+ * moves past it, along with stdin's offset when running stdin
+ */
+static ssize_t next_script_line (void *p, char **line)
+{
+    script_pos *pos = p;
+    if (pos->next >= pos->end) {
+        return -1;
+    }
+    char *nl = memchr(pos->next, '\n', pos->end - pos->next);
+    char *stop = (nl == NULL) ? pos->end : nl + 1;
+    *line = pos->next;
+    pos->next = stop;
+    if (pos->sync_fd >= 0) {
+        lseek(pos->sync_fd, pos->base + (stop - pos->map), SEEK_SET);
+    }
+    return stop - *line;
+}
+
+/**
+ * the last line of a file may not end in \n, which the tokenizer
+ * needs, and the mapping has no room to add one, so it gets copied
+ */
+static void run_last_line (const char *line, size_t len)
+{
+    char *tmp = malloc(len + 1);
+    if (tmp == NULL) {
+        perror("malloc failed in run_last_line");
+        exit(-1);
+    }
+    memcpy(tmp, line, len);
+    tmp[len] = '\n';
+    run_line_in_place(tmp, len + 1, NULL, NULL);
+    free(tmp);
+}
@@ -10,9 +10,12 @@
  ************************************************/
 
 #include "../includes/tokenizer.h"
+#include "../includes/scan.h"
+#include "../includes/vars.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <sys/resource.h>
 
 typedef enum {
@@ -22,27 +25,94 @@ typedef enum {
     Redirect_State,
     Single_Quote_State,
     Double_Quote_State,
+    Background_State,
 } Token_Sys_State;
 
-static void save_string (char*, ListHandler**, bool);
+/* the token being built. Tokens are packed one after another into
+ * arena memory, so a line's strings are usually one contiguous run */
+typedef struct {
+    char *buf; // start of the current token
+    size_t len;
+    size_t cap; // bytes available from buf
+    arena *mem;
+    bool in_place; // tokens may point into the input
+    char *src; // current token is src[0..len) of the input, not copied
+} tok_buf;
+
+static void tokenize_line (ListHandler *, char *, size_t, bool);
+static void reserve (tok_buf *, size_t);
+static void materialize (tok_buf *);
+static void put_char (tok_buf *, char);
+static void take (tok_buf *, char *, size_t);
+static size_t take_run (tok_buf *, char *, size_t);
+static void save_string (tok_buf *, ListHandler **, bool);
+static size_t take_subst (tok_buf *, ListHandler **, char *, size_t, size_t);
+static size_t close_paren (const char *, size_t, size_t);
+static bool starts_expansion (const char *, size_t);
+static bool starts_glob (const char *, size_t);
+static void take_glob (tok_buf *, char);
+static size_t take_expansion (tok_buf *, char *, size_t, size_t, bool);
 
 /**
  * Uses state machine to tokenize a user's input into appropriate
- * tokens for processing as shell commands
+ * tokens for processing as shell commands. Tokens are copied into the
+ * list's arena
+ */
+void tokenize (ListHandler *tlist, char *input, size_t length)
+{
+    tokenize_line(tlist, input, length, false);
+}
+
+/**
+ * Same as tokenize, but plain tokens point into input itself, ended by
+ * writing a \0 over the space, newline or quote after them. Only tokens
+ * that had to be put together (quoted, escaped, or touching a redirect)
+ * are copied. input must stay around as long as the tokens do
+ */
+void tokenize_in_place (ListHandler *tlist, char *input, size_t length)
+{
+    tokenize_line(tlist, input, length, true);
+}
+
+/**
+ * the state machine behind tokenize and tokenize_in_place
  */
-void tokenize (ListHandler *tlist, char *input)
+static void tokenize_line (ListHandler *tlist, char *input, size_t length,
+    bool in_place)
 {
-    int length = strlen(input);
-    if (input[length-1] != '\n') {
+    if (length == 0 || input[length-1] != '\n') {
         fprintf(stderr, "Input didn't end in \\n, skipping...\n");
         return;
     }
 
-    char token[length];
+    /* the marks hold substitutions in the token text, so they can't
+     * come from the input anywhere, quoted or not */
+    for (const char *m = MARKS; *m; m++) {
+        if (memchr(input, *m, length) != NULL) {
+            fprintf(stderr, "Unrecognized character \\x%02x\n", *m);
+            return;
+        }
+    }
+
+    tok_buf tb;
+    tb.mem = tlist->mem;
+    tb.len = 0;
+    tb.in_place = in_place;
+    tb.src = NULL;
+    if (in_place) { // arena is only needed for tokens that get copied
+        tb.cap = 0;
+        tb.buf = NULL;
+    } else {
+        /* every token needs at least one input char plus its \0, so
+         * twice the input length fits a whole line without growing */
+        tb.cap = 2 * length + 2;
+        tb.buf = arena_alloc(tb.mem, tb.cap);
+    }
+
     char ch;
     Token_Sys_State State = Init_State;
 
-    for(int i = 0, j = 0; i < length; i++) {
+    for(size_t i = 0; i < length; i++) {
         ch = input[i];
         switch (State) {
             /* Should only change for quotes or letters.
@@ -57,11 +127,22 @@ void tokenize (ListHandler *tlist, char *input)
                 } else if (ch == '<' || ch == '>' || ch == '|') {
                     fprintf(stderr, "Need input before redirect or pipe\n");
                     return;
+                } else if (ch == '&') {
+                    fprintf(stderr, "Need input before &\n");
+                    return;
                 } else if (ch == ' ') {
+                } else if (starts_expansion(input, i)) {
+                    State = Letter_State;
+                    i = take_expansion(&tb, input, i, length, false);
+                    if (i == 0) {
+                        return;
+                    }
+                } else if (starts_glob(input, i)) {
+                    State = Letter_State;
+                    take_glob(&tb, ch);
                 } else if (32 <= ch && ch <= 127) {
                     State = Letter_State;
-                    token[j] = ch;
-                    j++;
+                    take(&tb, input + i, 1);
                 } else {
                     fprintf(stderr, "Unrecognized character %c\n", ch);
                     return;
@@ -72,26 +153,32 @@ void tokenize (ListHandler *tlist, char *input)
              * Save string for redirect and newline */
             case Letter_State:
                 if (ch == '\n') {
-                    token[j] = '\0';
-                    save_string(token, &tlist, false);
+                    save_string(&tb, &tlist, false);
                 } else if (ch == '"') {
                     State = Double_Quote_State;
                 } else if (ch == '\'') {
                     State = Single_Quote_State;
                 } else if (ch == '<' || ch == '>' || ch == '|') {
                     State = Redirect_State;
-                    token[j] = '\0';
-                    save_string(token, &tlist, false);
-                    token[0] = ch;
-                    j = 1;
+                    save_string(&tb, &tlist, false);
+                    take(&tb, input + i, 1);
+                } else if (ch == '&') {
+                    State = Background_State;
+                    save_string(&tb, &tlist, false);
+                    take(&tb, input + i, 1);
                 } else if (ch == ' ') {
                     State = Blank_State;
-                    token[j] = '\0';
-                    save_string(token, &tlist, false);
-                    j = 0;
+                    save_string(&tb, &tlist, false);
+                } else if (starts_expansion(input, i)) {
+                    i = take_expansion(&tb, input, i, length, false);
+                    if (i == 0) {
+                        free_tok_list(tlist);
+                        return;
+                    }
+                } else if (starts_glob(input, i)) {
+                    take_glob(&tb, ch);
                 } else if (32 <= ch && ch <= 127) {
-                    token[j] = ch;
-                    j++;
+                    i += take_run(&tb, input + i, length - i) - 1;
                 } else {
                     fprintf(stderr, "Unrecognized character %c\n", ch);
                     free_tok_list(tlist);
@@ -106,41 +193,68 @@ void tokenize (ListHandler *tlist, char *input)
                     State = Double_Quote_State;
                 } else if (ch == '\'') {
                     State = Single_Quote_State;
+                } else if ((ch == '<' || ch == '>') && input[i+1] == '(') {
+                    i = take_subst(&tb, &tlist, input, i, length);
+                    if (i == 0) {
+                        free_tok_list(tlist);
+                        return;
+                    }
                 } else if (ch == '<' || ch == '>' || ch == '|') {
                     State = Redirect_State;
-                    token[j] = ch;
-                    j++;
+                    take(&tb, input + i, 1);
+                } else if (ch == '&') {
+                    State = Background_State;
+                    take(&tb, input + i, 1);
                 } else if (ch == ' ') {
+                } else if (starts_expansion(input, i)) {
+                    State = Letter_State;
+                    i = take_expansion(&tb, input, i, length, false);
+                    if (i == 0) {
+                        free_tok_list(tlist);
+                        return;
+                    }
+                } else if (starts_glob(input, i)) {
+                    State = Letter_State;
+                    take_glob(&tb, ch);
                 } else if (32 <= ch && ch <= 127) {
                     State = Letter_State;
-                    token[j] = ch;
-                    j++;
+                    take(&tb, input + i, 1);
                 } else {
                     fprintf(stderr, "Unrecognized character %c\n", ch);
                     free_tok_list(tlist);
                     return;
                 }
                 break;
-            /* save ch for another > if >.
+            /* save ch for another > if >, or for up to two
+             * more < if < (here documents and strings).
+             * <(cmd) or >(cmd) after a space is the file.
              * error on any other redirect or newline
              * save string and change for anything else
              * */
             case Redirect_State:
                 if (ch == '"') {
                     State = Double_Quote_State;
-                    token[j] = '\0';
-                    save_string(token, &tlist, true);
-                    j = 0;
+                    save_string(&tb, &tlist, true);
                 } else if (ch == '\'') {
                     State = Single_Quote_State;
-                    token[j] = '\0';
-                    save_string(token, &tlist, true);
-                    j = 0;
+                    save_string(&tb, &tlist, true);
                 } else if (ch == '\n') {
                     fprintf(stderr, "Can't have redirect at end of input\n");
                     free_tok_list(tlist);;
                     return;
-                } else if (ch == '<' || ch == '|') {
+                } else if ((ch == '<' || ch == '>') && input[i+1] == '(' &&
+                    input[i-1] == ' ') { // < <(cmd)
+                    save_string(&tb, &tlist, true);
+                    i = take_subst(&tb, &tlist, input, i, length);
+                    if (i == 0) {
+                        free_tok_list(tlist);
+                        return;
+                    }
+                    State = Blank_State;
+                } else if (ch == '<' && input[i-1] == '<' &&
+                    !(i >= 3 && input[i-2] == '<' && input[i-3] == '<')) {
+                    take(&tb, input + i, 1); // << or <<<
+                } else if (ch == '<' || ch == '|' || ch == '&') {
                     fprintf(stderr, "%c not valid after >\n", ch);
                     free_tok_list(tlist);;
                     return;
@@ -151,8 +265,7 @@ void tokenize (ListHandler *tlist, char *input)
                             free_tok_list(tlist);;
                             return;
                         }
-                        token[j] = ch;
-                        j++;
+                        take(&tb, input + i, 1);
                     } else {
                         fprintf(stderr,
                             "Cannot have spaces between >\n");
@@ -160,12 +273,18 @@ void tokenize (ListHandler *tlist, char *input)
                         return;
                     }
                 } else if (ch == ' ') {
+                } else if (starts_expansion(input, i)) {
+                    State = Letter_State;
+                    save_string(&tb, &tlist, true);
+                    i = take_expansion(&tb, input, i, length, false);
+                    if (i == 0) {
+                        free_tok_list(tlist);
+                        return;
+                    }
                 } else if (32 <= ch && ch <= 127) {
                     State = Letter_State;
-                    token[j] = '\0';
-                    save_string(token, &tlist, true);
-                    token[0] = ch;
-                    j = 1;
+                    save_string(&tb, &tlist, true);
+                    take(&tb, input + i, 1);
                 } else {
                     fprintf(stderr, "Unrecognized character %c\n", ch);
                     free_tok_list(tlist);;
@@ -185,22 +304,24 @@ void tokenize (ListHandler *tlist, char *input)
                     } else if (ch == '\'') {
                     } else if (ch == '<' || ch == '>' || ch == '|') {
                         State = Redirect_State;
-                        token[j] = '\0';
-                        save_string(token, &tlist, false);
-                        token[0] = ch;
-                        j = 1;
+                        save_string(&tb, &tlist, false);
+                        take(&tb, input + i, 1);
+                    } else if (ch == '&') {
+                        State = Background_State;
+                        save_string(&tb, &tlist, false);
+                        take(&tb, input + i, 1);
                     } else if (ch == ' ') {
                         State = Blank_State;
-                        token[j] = '\0';
-                        save_string(token, &tlist, false);
-                        j = 0;
+                        save_string(&tb, &tlist, false);
+                    } else if (starts_expansion(input, i) ||
+                        starts_glob(input, i)) {
+                        State = Letter_State;
+                        i--; // Letter_State takes it
                     } else if (32 <= ch && ch <= 127) {
                         State = Letter_State;
-                        token[j] = ch;
-                        j++;
+                        take(&tb, input + i, 1);
                     } else if (ch == '\n') {
-                        token[j] = '\0';
-                        save_string(token, &tlist, false);
+                        save_string(&tb, &tlist, false);
                     } else {
                         fprintf(stderr, "Unrecognized character %c\n", ch);
                         free_tok_list(tlist);;
@@ -214,24 +335,23 @@ void tokenize (ListHandler *tlist, char *input)
                     i++;
                     char ec = input[i];
                     if (ec == 'n') {
-                        token[j++] = '\n';
+                        put_char(&tb, '\n');
                     } else if (ec == 'b') {
-                        token[j++] = '\b';
+                        put_char(&tb, '\b');
                     } else if (ec == 'r') {
-                        token[j++] = '\r';
+                        put_char(&tb, '\r');
                     } else if (ec == 't') {
-                        token[j++] = '\t';
+                        put_char(&tb, '\t');
                     } else if (ec == 'v') {
-                        token[j++] = '\v';
+                        put_char(&tb, '\v');
                     } else if (ec == '0') {
-                        token[j++] = '\0';
+                        put_char(&tb, '\0');
                     } else {
-                        token[j++] = input[i-1];
-                        token[j++] = ec;
+                        put_char(&tb, input[i-1]);
+                        put_char(&tb, ec);
                     }
                 } else {
-                    token[j] = ch;
-                    j++;
+                    i += take_run(&tb, input + i, length - i) - 1;
                 }
                 break;
             /** see single quote explanation    */
@@ -244,22 +364,24 @@ void tokenize (ListHandler *tlist, char *input)
                     } else if (ch == '"') {
                     } else if (ch == '<' || ch == '>' || ch == '|') {
                         State = Redirect_State;
-                        token[j] = '\0';
-                        save_string(token, &tlist, false);
-                        token[0] = ch;
-                        j = 1;
+                        save_string(&tb, &tlist, false);
+                        take(&tb, input + i, 1);
+                    } else if (ch == '&') {
+                        State = Background_State;
+                        save_string(&tb, &tlist, false);
+                        take(&tb, input + i, 1);
                     } else if (ch == ' ') {
                         State = Blank_State;
-                        token[j] = '\0';
-                        save_string(token, &tlist, false);
-                        j = 0;
+                        save_string(&tb, &tlist, false);
+                    } else if (starts_expansion(input, i) ||
+                        starts_glob(input, i)) {
+                        State = Letter_State;
+                        i--; // Letter_State takes it
                     } else if (32 <= ch && ch <= 127) {
                         State = Letter_State;
-                        token[j] = ch;
-                        j++;
+                        take(&tb, input + i, 1);
                     } else if (ch == '\n') {
-                        token[j] = '\0';
-                        save_string(token, &tlist, false);
+                        save_string(&tb, &tlist, false);
                     } else {
                         fprintf(stderr, "Unrecognized character %c\n", ch);
                         free_tok_list(tlist);;
@@ -269,28 +391,46 @@ void tokenize (ListHandler *tlist, char *input)
                     fprintf(stderr, "Quote never closed \"\n");
                     free_tok_list(tlist);;
                     return;
+                } else if (starts_expansion(input, i)) {
+                    i = take_expansion(&tb, input, i, length, true);
+                    if (i == 0) {
+                        free_tok_list(tlist);
+                        return;
+                    }
                 } else if (ch == '\\') { // handle escaped characters
                     i++;
                     char ec = input[i];
                     if (ec == 'n') {
-                        token[j++] = '\n';
+                        put_char(&tb, '\n');
                     } else if (ec == 'b') {
-                        token[j++] = '\b';
+                        put_char(&tb, '\b');
                     } else if (ec == 'r') {
-                        token[j++] = '\r';
+                        put_char(&tb, '\r');
                     } else if (ec == 't') {
-                        token[j++] = '\t';
+                        put_char(&tb, '\t');
                     } else if (ec == 'v') {
-                        token[j++] = '\v';
+                        put_char(&tb, '\v');
                     } else if (ec == '0') {
-                        token[j++] = '\0';
+                        put_char(&tb, '\0');
                     } else {
-                        token[j++] = input[i-1];
-                        token[j++] = ec;
+                        put_char(&tb, input[i-1]);
+                        put_char(&tb, ec);
                     }
                 } else {
-                    token[j] = ch;
-                    j++;
+                    i += take_run(&tb, input + i, length - i) - 1;
+                }
+                break;
+            /* & has to be the last thing on the line.
+             * Save it once the char after it is seen */
+            case Background_State:
+                if (ch == '\n' || ch == ' ') {
+                    if (tb.len > 0) {
+                        save_string(&tb, &tlist, true);
+                    }
+                } else {
+                    fprintf(stderr, "& can only end a command\n");
+                    free_tok_list(tlist);
+                    return;
                 }
                 break;
             default:
@@ -301,66 +441,318 @@ void tokenize (ListHandler *tlist, char *input)
 }
 
 /**
- * Inserts a new node at the end of the linked list pointed to by head
- * with the given string token and marks whether it is a special
- * token or not based on spec */
-static void save_string (char *token, ListHandler **tlist, bool spec)
+ * Makes room for n more chars and a \0 after the token being built,
+ * moving the token to a bigger piece of the arena if needed
+ */
+static void reserve (tok_buf *tb, size_t n)
 {
-    tok_node *t_node = malloc(sizeof(tok_node)); // make new node
-    int length = strlen(token);
-    if (t_node == NULL) {
-        perror("malloc failed in save_string");
-        exit(-1);
+    if (tb->len + n >= tb->cap) {
+        size_t cap = 2 * (tb->len + n) + 64;
+        char *buf = arena_alloc(tb->mem, cap);
+        if (tb->len) {
+            memcpy(buf, tb->buf, tb->len);
+        }
+        tb->buf = buf;
+        tb->cap = cap;
     }
-    t_node->token = malloc(sizeof(char)*length+1); // make space for token
-    if (t_node->token == NULL) {
-        perror("malloc failed in save_string");
-        exit(-1);
+}
+
+/**
+ * Copies a token that still points into the input into the arena
+ */
+static void materialize (tok_buf *tb)
+{
+    if (tb->src == NULL) {
+        return;
+    }
+    size_t len = tb->len;
+    tb->len = 0;
+    reserve(tb, len);
+    memcpy(tb->buf, tb->src, len);
+    tb->len = len;
+    tb->src = NULL;
+}
+
+/**
+ * Adds a char that isn't in the input as is, like an escape
+ */
+static void put_char (tok_buf *tb, char ch)
+{
+    materialize(tb);
+    reserve(tb, 1);
+    tb->buf[tb->len++] = ch;
+}
+
+/**
+ * Adds n chars of the input to the token being built. In place, a
+ * token that is one unbroken piece of the input is only pointed at
+ */
+static void take (tok_buf *tb, char *input, size_t n)
+{
+    if (tb->in_place) {
+        if (tb->src == NULL && tb->len == 0) {
+            tb->src = input;
+            tb->len = n;
+            return;
+        }
+        if (tb->src != NULL && tb->src + tb->len == input) {
+            tb->len += n;
+            return;
+        }
+        materialize(tb);
+    }
+    reserve(tb, n);
+    memcpy(tb->buf + tb->len, input, n);
+    tb->len += n;
+}
+
+/**
+ * Adds input[0] and the run of plain chars after it to the token being
+ * built in one go. Returns how many chars were added
+ */
+static size_t take_run (tok_buf *tb, char *input, size_t avail)
+{
+    size_t run = 1 + scan_plain(input + 1, avail - 1);
+    take(tb, input, run);
+    return run;
+}
+
+/**
+ * Ends the token being built and appends it to the token array,
+ * marking whether it is a special token or not based on spec */
+static void save_string (tok_buf *tb, ListHandler **tlist, bool spec)
+{
+    ListHandler *list = *tlist;
+    if (list->count == list->cap) { // grow the array inside the arena
+        int cap = list->cap ? list->cap * 2 : 16;
+        tok_node *toks = arena_alloc(list->mem, sizeof(tok_node) * cap);
+        if (list->count) {
+            memcpy(toks, list->head, sizeof(tok_node) * list->count);
+        }
+        list->head = toks;
+        list->cap = cap;
     }
-    strncpy(t_node->token, token, length+1); // put token in node
-    t_node->token[length] = '\0'; // in case strncpy doesn't null terminate
-    t_node->special = spec; // set if token is special
-    t_node->next = NULL; // set next to NULL, node is going at the end
 
-    if ((*tlist)->head == NULL) { // if head is NULL, new node is head
-        (*tlist)->head = t_node;
-        (*tlist)->tail = t_node;
-        (*tlist)->count = 1;
-    } else { // otherwise insert node at the end
-        ((tok_node *)(*tlist)->tail)->next = t_node;
-        (*tlist)->tail = t_node;
-        (*tlist)->count++;
+    /* a borrowed token can be ended in the input if the char after it
+     * has already been read and isn't part of another token */
+    if (tb->src != NULL) {
+        char next = tb->src[tb->len];
+        if (next == ' ' || next == '\n' || next == '"' || next == '\'') {
+            tb->src[tb->len] = '\0';
+            list->head[list->count].token = tb->src;
+            list->head[list->count].special = spec;
+            list->count++;
+            tb->src = NULL;
+            tb->len = 0;
+            return;
+        }
+        materialize(tb);
     }
+
+    reserve(tb, 0);
+    tb->buf[tb->len] = '\0';
+    list->head[list->count].token = tb->buf;
+    list->head[list->count].special = spec; // set if token is special
+    list->count++;
+
+    /* next token starts right after this one */
+    tb->buf += tb->len + 1;
+    tb->cap -= tb->len + 1;
+    tb->len = 0;
     return;
 }
 
 /**
- * call to free all nodes
+ * Saves <(cmd) or >(cmd), starting at input[i], as one special token.
+ * It is always copied, as the char after it hasn't been read yet.
+ * Returns the index of its ), or 0 with an error printed if it
+ * never closes
  */
-void free_tok_list (ListHandler *tlist)
+static size_t take_subst (tok_buf *tb, ListHandler **tlist, char *input,
+    size_t i, size_t length)
+{
+    size_t end = close_paren(input, i + 1, length);
+    if (end == 0) {
+        fprintf(stderr, "Process substitution never closed\n");
+        return 0;
+    }
+    take(tb, input + i, end + 1 - i);
+    materialize(tb);
+    save_string(tb, tlist, true);
+    return end;
+}
+
+/**
+ * true if input[i] starts a $(cmd), `cmd`, $NAME or ${NAME}
+ */
+static bool starts_expansion (const char *input, size_t i)
+{
+    char next = input[i+1];
+    return input[i] == '`' || (input[i] == '$' && (next == '(' ||
+        next == '{' || next == '_' || isalpha((unsigned char)next)));
+}
+
+/**
+ * true if input[i] is an unquoted *, ? or [ that makes the word a
+ * filename pattern. A [ only does if a ] closes it in the same word
+ */
+static bool starts_glob (const char *input, size_t i)
+{
+    char ch = input[i];
+    if (ch == '*' || ch == '?') {
+        return true;
+    } else if (ch != '[') {
+        return false;
+    }
+    for (size_t k = i + 1;; k++) {
+        ch = input[k];
+        if (ch == ']' && k > i + 1) {
+            return true;
+        } else if (ch == ' ' || ch == '\n' || ch == '"' || ch == '\'' ||
+            ch == '<' || ch == '>' || ch == '|' || ch == '&') {
+            return false;
+        }
+    }
+}
+
+/**
+ * Adds a pattern char to the token being built with MARK_GLOB before
+ * it, so expansion can tell it from a quoted one
+ */
+static void take_glob (tok_buf *tb, char ch)
+{
+    put_char(tb, MARK_GLOB);
+    put_char(tb, ch);
+}
+
+/**
+ * Adds the $(cmd), `cmd`, $NAME or ${NAME} starting at input[i] to the
+ * token being built as a mark (MARK_CMD or MARK_VAR), q if it is
+ * quoted else u, the cmd or NAME and the mark again. It is swapped for
+ * cmd's output or NAME's value each time the line runs. Returns the
+ * index of its last char, or 0 with an error printed if it is broken
+ */
+static size_t take_expansion (tok_buf *tb, char *input, size_t i,
+    size_t length, bool quoted)
+{
+    char mark = MARK_CMD;
+    size_t start, end = 0;
+    if (input[i] == '$' && input[i+1] == '(') {
+        start = i + 2;
+        end = close_paren(input, i + 1, length);
+    } else if (input[i] == '$' && input[i+1] == '{') {
+        mark = MARK_VAR;
+        start = i + 2;
+        char *close = memchr(input + start, '}', length - start);
+        if (close == NULL ||
+            !var_name_ok(input + start, close - (input + start))) {
+            fprintf(stderr, "Bad substitution\n");
+            return 0;
+        }
+        end = close - input;
+    } else if (input[i] == '$') {
+        mark = MARK_VAR;
+        start = i + 1;
+        end = start;
+        while (isalnum((unsigned char)input[end+1]) || input[end+1] == '_') {
+            end++;
+        }
+    } else {
+        start = i + 1;
+        for (size_t k = start; k < length && input[k] != '\n'; k++) {
+            if (input[k] == '\\') {
+                k++;
+            } else if (input[k] == '`') {
+                end = k;
+                break;
+            }
+        }
+    }
+    if (end == 0) {
+        fprintf(stderr, "Command substitution never closed\n");
+        return 0;
+    }
+    size_t stop = (mark == MARK_VAR && input[i+1] != '{') ? end + 1 : end;
+    put_char(tb, mark);
+    put_char(tb, quoted ? 'q' : 'u');
+    take(tb, input + start, stop - start);
+    put_char(tb, mark);
+    return end;
+}
+
+/**
+ * finds the ) closing the ( at input[open], stepping over nested ones
+ * and anything quoted. Returns 0 if the line ends first
+ */
+static size_t close_paren (const char *input, size_t open, size_t length)
 {
-    tok_node *temp = tlist->head;
-    while (temp != NULL) {
-        tlist->head = ((tok_node *)tlist->head)->next;
-        free(temp->token);
-        free(temp);
-        temp = tlist->head;
+    int depth = 0;
+    char quote = 0;
+    for (size_t i = open; i < length && input[i] != '\n'; i++) {
+        char ch = input[i];
+        if (quote != 0) {
+            if (ch == quote) {
+                quote = 0;
+            } else if (ch == '\\') {
+                i++;
+            }
+        } else if (ch == '\'' || ch == '"') {
+            quote = ch;
+        } else if (ch == '(') {
+            depth++;
+        } else if (ch == ')' && --depth == 0) {
+            return i;
+        }
     }
+    return 0;
+}
+
+/**
+ * sets up an empty token list with its own arena
+ */
+void init_tok_list (ListHandler *tlist)
+{
     tlist->head = NULL;
-    tlist->tail = NULL;
     tlist->count = 0;
+    tlist->cap = 0;
+    tlist->mem = calloc(1, sizeof(arena));
+    if (tlist->mem == NULL) {
+        perror("malloc failed in init_tok_list");
+        exit(-1);
+    }
+}
+
+/**
+ * call to drop all tokens. The arena is kept for the next line
+ */
+void free_tok_list (ListHandler *tlist)
+{
+    arena_reset(tlist->mem);
+    tlist->head = NULL;
+    tlist->count = 0;
+    tlist->cap = 0;
     return;
 }
 
+/**
+ * frees the tokens and the arena itself
+ */
+void destroy_tok_list (ListHandler *tlist)
+{
+    free_tok_list(tlist);
+    arena_free(tlist->mem);
+    free(tlist->mem);
+    tlist->mem = NULL;
+}
+
 /**
  * prints all the tokens in the list and whether
  * they are special or not
  */
-void print_tokens (tok_node *head)
+void print_tokens (ListHandler tlist)
 {
-    tok_node *list = head;
-    while (list != NULL) {
-        printf("%d:%s\n", list->special, list->token);
-        list = list->next;
+    for (int i = 0; i < tlist.count; i++) {
+        printf("%d:%s\n", tlist.head[i].special, tlist.head[i].token);
     }
 }
+
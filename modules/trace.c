@@ -0,0 +1,200 @@
+/************************************************
+ *                   trace.c                    *
+ ************************************************
+ * trace times the phases each command line     *
+ * goes through and keeps process wide counters *
+ * of the work done. Phase times can be        *
+ * streamed out as one JSON record per line     *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define RECORD_SIZE 4096
+#define MAX_CMD_CHARS 1024
+
+static const char *phase_names[PHASE_CT] = {
+    "read", "tokenize", "builtin", "lookup", "spawn", "wait"
+};
+
+static const char *counter_names[COUNTER_CT] = {
+    "lines", "arena_allocs", "arena_blocks", "spawns", "forks",
+    "dir_scans", "path_hits", "path_misses", "cmd_cache_hits",
+    "cmd_cache_misses"
+};
+
+static size_t json_str (char *, size_t, const char *, size_t);
+
+bool trace_on = false;
+unsigned long trace_counters[COUNTER_CT];
+
+static uint64_t phase_total[PHASE_CT]; // ns over the whole session
+static unsigned long phase_calls[PHASE_CT];
+static uint64_t line_phase[PHASE_CT]; // ns for the current line
+static uint64_t line_start = 0;
+static unsigned long seq = 0;
+static int trace_fd = -1; // where JSON records go
+
+/**
+ * turns tracing on if $MYCLI_TRACE is set. A number is taken as an
+ * open fd to write records to, anything else as a file to append to
+ */
+void trace_init ()
+{
+    const char *dest = getenv("MYCLI_TRACE");
+    if (dest == NULL || *dest == '\0') {
+        return;
+    }
+    char *end;
+    long fd = strtol(dest, &end, 10);
+    if (*end == '\0') {
+        trace_fd = fd;
+    } else {
+        trace_fd = open(dest, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+            S_IRUSR | S_IWUSR);
+        if (trace_fd < 0) {
+            perror(dest);
+        }
+    }
+    trace_on = true;
+}
+
+/**
+ * starts or stops timing phases
+ */
+void trace_enable (bool on)
+{
+    trace_on = on;
+}
+
+/**
+ * nanoseconds on the monotonic clock
+ */
+uint64_t trace_ns ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * adds the time since start to a phase
+ */
+void trace_add (trace_phase phase, uint64_t start)
+{
+    uint64_t ns = trace_ns() - start;
+    phase_total[phase] += ns;
+    phase_calls[phase]++;
+    line_phase[phase] += ns;
+}
+
+/**
+ * marks the start of running a line. Reading it has already been
+ * counted, so that shows up in this line's record too
+ */
+void trace_line_begin ()
+{
+    trace_count(CNT_LINES);
+    line_start = trace_start();
+}
+
+/**
+ * ends the current line, writing its JSON record if records are being
+ * streamed, and clears its phase times
+ */
+void trace_line_end (const char *line, size_t len)
+{
+    if (trace_on && trace_fd >= 0 && line_start != 0) {
+        char rec[RECORD_SIZE];
+        size_t n = snprintf(rec, sizeof(rec),
+            "{\"seq\":%lu,\"start_ns\":%llu,\"total_ns\":%llu", ++seq,
+            (unsigned long long)line_start,
+            (unsigned long long)(trace_ns() - line_start));
+        for (int p = 0; p < PHASE_CT; p++) {
+            n += snprintf(rec + n, sizeof(rec) - n, ",\"%s_ns\":%llu",
+                phase_names[p], (unsigned long long)line_phase[p]);
+        }
+        if (len > 0 && (line[len-1] == '\n' || line[len-1] == '\0')) {
+            len--;
+        }
+        n += snprintf(rec + n, sizeof(rec) - n, ",\"cmd\":");
+        n += json_str(rec + n, sizeof(rec) - n - 3, line,
+            len < MAX_CMD_CHARS ? len : MAX_CMD_CHARS);
+        n += snprintf(rec + n, sizeof(rec) - n, "}\n");
+        if (write(trace_fd, rec, n) < 0) {
+            perror("trace write failed");
+            trace_fd = -1;
+        }
+    }
+    memset(line_phase, 0, sizeof(line_phase));
+    line_start = 0;
+}
+
+/**
+ * prints the counters and, if anything was timed, the phase totals
+ */
+void trace_print ()
+{
+    for (int c = 0; c < COUNTER_CT; c++) {
+        printf("%-18s %lu\n", counter_names[c], trace_counters[c]);
+    }
+    printf("%-18s %s\n", "phase timing", trace_on ? "on" : "off");
+    bool header = false;
+    for (int p = 0; p < PHASE_CT; p++) {
+        if (phase_calls[p] == 0) {
+            continue;
+        }
+        if (!header) {
+            printf("%-10s %10s %14s %12s\n", "phase", "calls", "total ns",
+                "avg ns");
+            header = true;
+        }
+        printf("%-10s %10lu %14llu %12llu\n", phase_names[p], phase_calls[p],
+            (unsigned long long)phase_total[p],
+            (unsigned long long)(phase_total[p] / phase_calls[p]));
+    }
+}
+
+/**
+ * zeroes the counters and phase totals
+ */
+void trace_reset ()
+{
+    memset(trace_counters, 0, sizeof(trace_counters));
+    memset(phase_total, 0, sizeof(phase_total));
+    memset(phase_calls, 0, sizeof(phase_calls));
+}
+
+/**
+ * writes s as a quoted JSON string into out, escaping as needed and
+ * stopping early if out runs out of room. Returns the length written
+ */
+static size_t json_str (char *out, size_t room, const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t n = 0;
+    out[n++] = '"';
+    for (size_t i = 0; i < len && n + 7 < room; i++) {
+        unsigned char c = s[i];
+        if (c == '\0') { // ended a token of an in place line
+            out[n++] = ' ';
+        } else if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = c;
+        } else if (c < 0x20) {
+            n += sprintf(out + n, "\\u00%c%c", hex[c >> 4], hex[c & 15]);
+        } else {
+            out[n++] = c;
+        }
+    }
+    out[n++] = '"';
+    return n;
+}
@@ -0,0 +1,393 @@
+/************************************************
+ *                   vars.c                     *
+ ************************************************
+ * vars keeps the shell's variables in an open  *
+ * addressing hash table, and the exported ones *
+ * in an envp array that is updated in place as *
+ * they change, so it can go straight to exec   *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/vars.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MIN_SLOTS 64
+#define TOMBSTONE ((var *)1) // a removed var, probes go past it
+
+extern char **environ;
+
+typedef struct {
+    char *entry; // NAME=value, as it goes in envp
+    size_t name_len;
+    unsigned long hash;
+    int env_slot; // index in envp, -1 if not exported
+} var;
+
+static var **slots = NULL; // NULL, TOMBSTONE or a var
+static size_t slot_ct = 0; // a power of 2
+static size_t used = 0; // vars and tombstones, for the load factor
+static size_t live = 0;
+
+/* exported vars, in no order. env_vars[i] owns envp[i] */
+static char **envp = NULL;
+static var **env_vars = NULL;
+static int env_ct = 0;
+static int env_cap = 0;
+
+static void load_environ ();
+static unsigned long hash_name (const char *, size_t);
+static var **find (const char *, size_t, unsigned long);
+static var *lookup (const char *, size_t);
+static void rehash (size_t);
+static void env_add (var *);
+static void env_remove (var *);
+
+/**
+ * the value of a variable, NULL if it isn't set
+ */
+const char *var_get (const char *name)
+{
+    return var_getn(name, strlen(name));
+}
+
+/**
+ * the value of the variable named by the len chars at name, which don't
+ * have to end in \0. NULL if it isn't set
+ */
+const char *var_getn (const char *name, size_t len)
+{
+    if (slots == NULL) {
+        load_environ();
+    }
+    var *v = lookup(name, len);
+    return v ? v->entry + v->name_len + 1 : NULL;
+}
+
+/**
+ * sets a variable, exporting it if export. A var that is already
+ * exported stays exported. Returns false if name isn't a valid name
+ */
+bool var_set (const char *name, const char *value, bool export)
+{
+    return var_setn(name, strlen(name), value, export);
+}
+
+/**
+ * var_set for a name given as len chars that don't have to end in \0
+ */
+bool var_setn (const char *name, size_t len, const char *value, bool export)
+{
+    if (!var_name_ok(name, len)) {
+        return false;
+    }
+    if (slots == NULL) {
+        load_environ();
+    }
+    size_t value_len = strlen(value);
+    char *entry = malloc(len + value_len + 2);
+    if (entry == NULL) {
+        perror("malloc failed in var_set");
+        exit(-1);
+    }
+    memcpy(entry, name, len);
+    entry[len] = '=';
+    memcpy(entry + len + 1, value, value_len + 1);
+
+    unsigned long hash = hash_name(name, len);
+    var **slot = find(name, len, hash);
+    var *v = *slot;
+    if (v != NULL && v != TOMBSTONE) {
+        free(v->entry);
+        v->entry = entry;
+        if (v->env_slot >= 0) {
+            envp[v->env_slot] = entry;
+        } else if (export) {
+            env_add(v);
+        }
+        return true;
+    }
+
+    v = malloc(sizeof(var));
+    if (v == NULL) {
+        perror("malloc failed in var_set");
+        exit(-1);
+    }
+    v->entry = entry;
+    v->name_len = len;
+    v->hash = hash;
+    v->env_slot = -1;
+    if ((used + 1) * 4 > slot_ct * 3) { // over 3/4 full
+        rehash(live + 1);
+        slot = find(name, len, hash);
+    }
+    used += (*slot == NULL);
+    *slot = v;
+    live++;
+    if (export) {
+        env_add(v);
+    }
+    return true;
+}
+
+/**
+ * removes a variable, and takes it out of the environment
+ */
+void var_unset (const char *name)
+{
+    if (slots == NULL) {
+        load_environ();
+    }
+    size_t len = strlen(name);
+    var **slot = find(name, len, hash_name(name, len));
+    var *v = *slot;
+    if (v == NULL || v == TOMBSTONE) {
+        return; // not set
+    }
+    if (v->env_slot >= 0) {
+        env_remove(v);
+    }
+    *slot = TOMBSTONE;
+    live--;
+    free(v->entry);
+    free(v);
+}
+
+/**
+ * puts a set variable in the environment. Returns false if it isn't set
+ */
+bool var_export (const char *name)
+{
+    if (slots == NULL) {
+        load_environ();
+    }
+    size_t len = strlen(name);
+    var *v = lookup(name, len);
+    if (v == NULL) {
+        return false;
+    }
+    if (v->env_slot < 0) {
+        env_add(v);
+    }
+    return true;
+}
+
+/**
+ * the NULL terminated NAME=value array of exported variables, to hand
+ * to exec as is. It changes as variables do, environ always points
+ * at it
+ */
+char **var_envp ()
+{
+    if (slots == NULL) {
+        load_environ();
+    }
+    return envp;
+}
+
+/**
+ * true if the len chars at name make a variable name: a letter or _
+ * then letters, digits and _s
+ */
+bool var_name_ok (const char *name, size_t len)
+{
+    if (len == 0 || (!isalpha((unsigned char)name[0]) && name[0] != '_')) {
+        return false;
+    }
+    for (size_t i = 1; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * the length of NAME if word is a NAME=value assignment, else 0
+ */
+size_t var_assign_len (const char *word)
+{
+    const char *eq = strchr(word, '=');
+    if (eq == NULL || !var_name_ok(word, eq - word)) {
+        return 0;
+    }
+    return eq - word;
+}
+
+/**
+ * prints every variable, or only the exported ones, as NAME=value
+ */
+void var_print (bool exported_only)
+{
+    if (slots == NULL) {
+        load_environ();
+    }
+    if (exported_only) {
+        for (int i = 0; i < env_ct; i++) {
+            printf("%s\n", envp[i]);
+        }
+        return;
+    }
+    for (size_t i = 0; i < slot_ct; i++) {
+        if (slots[i] != NULL && slots[i] != TOMBSTONE) {
+            printf("%s\n", slots[i]->entry);
+        }
+    }
+}
+
+/**
+ * fills the table from the environment the shell was started with,
+ * everything exported, and points environ at envp from then on
+ */
+static void load_environ ()
+{
+    size_t count = 0;
+    while (environ != NULL && environ[count] != NULL) {
+        count++;
+    }
+    rehash(count);
+    env_cap = count + 16;
+    envp = malloc(sizeof(char *) * (env_cap + 1));
+    env_vars = malloc(sizeof(var *) * env_cap);
+    if (envp == NULL || env_vars == NULL) {
+        perror("malloc failed in load_environ");
+        exit(-1);
+    }
+    envp[0] = NULL;
+    char **old = environ;
+    environ = envp;
+    for (size_t i = 0; i < count; i++) {
+        const char *eq = strchr(old[i], '=');
+        if (eq == NULL) {
+            continue;
+        }
+        var_setn(old[i], eq - old[i], eq + 1, true);
+    }
+}
+
+/**
+ * FNV-1a hash of the len chars at name
+ */
+static unsigned long hash_name (const char *name, size_t len)
+{
+    unsigned long h = 14695981039346656037UL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+/**
+ * the slot holding a variable, or the slot it would go in, which is
+ * the first tombstone passed if there was one. Probes linearly
+ */
+static var **find (const char *name, size_t len, unsigned long hash)
+{
+    size_t mask = slot_ct - 1;
+    var **free_slot = NULL;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        var *v = slots[i];
+        if (v == NULL) {
+            return free_slot ? free_slot : &slots[i];
+        }
+        if (v == TOMBSTONE) {
+            if (free_slot == NULL) {
+                free_slot = &slots[i];
+            }
+        } else if (v->hash == hash && v->name_len == len &&
+            !memcmp(v->entry, name, len)) {
+            return &slots[i];
+        }
+    }
+}
+
+/**
+ * the variable named by the len chars at name, NULL if it isn't set.
+ * find can hand back a tombstone for a name that isn't there
+ */
+static var *lookup (const char *name, size_t len)
+{
+    var *v = *find(name, len, hash_name(name, len));
+    return v == TOMBSTONE ? NULL : v;
+}
+
+/**
+ * moves every variable into a table sized for at least count of them,
+ * dropping the tombstones
+ */
+static void rehash (size_t count)
+{
+    size_t new_ct = MIN_SLOTS;
+    while (new_ct < count * 2) {
+        new_ct *= 2;
+    }
+    var **old = slots;
+    size_t old_ct = slot_ct;
+    slots = calloc(new_ct, sizeof(var *));
+    if (slots == NULL) {
+        perror("malloc failed in rehash");
+        exit(-1);
+    }
+    slot_ct = new_ct;
+    used = live;
+    for (size_t i = 0; i < old_ct; i++) {
+        var *v = old[i];
+        if (v == NULL || v == TOMBSTONE) {
+            continue;
+        }
+        size_t k = v->hash & (new_ct - 1);
+        while (slots[k] != NULL) {
+            k = (k + 1) & (new_ct - 1);
+        }
+        slots[k] = v;
+    }
+    free(old);
+}
+
+/**
+ * appends a variable to envp
+ */
+static void env_add (var *v)
+{
+    if (env_ct == env_cap) {
+        int cap = env_cap * 2;
+        char **tmp = realloc(envp, sizeof(char *) * (cap + 1));
+        if (tmp == NULL) {
+            perror("realloc failed in env_add");
+            exit(-1);
+        }
+        envp = tmp;
+        environ = envp;
+        var **vtmp = realloc(env_vars, sizeof(var *) * cap);
+        if (vtmp == NULL) {
+            perror("realloc failed in env_add");
+            exit(-1);
+        }
+        env_vars = vtmp;
+        env_cap = cap;
+    }
+    v->env_slot = env_ct;
+    envp[env_ct] = v->entry;
+    env_vars[env_ct] = v;
+    env_ct++;
+    envp[env_ct] = NULL;
+}
+
+/**
+ * takes a variable out of envp by moving the last one into its place
+ */
+static void env_remove (var *v)
+{
+    int i = v->env_slot;
+    env_ct--;
+    envp[i] = envp[env_ct];
+    env_vars[i] = env_vars[env_ct];
+    env_vars[i]->env_slot = i;
+    envp[env_ct] = NULL;
+    v->env_slot = -1;
+}
@@ -0,0 +1,428 @@
+/************************************************
+ *                 wildcard.c                   *
+ ************************************************
+ * wildcard expands a word with unquoted *, ?   *
+ * and [...] in it to the paths it matches.     *
+ * Each part of the path is compiled to runs of *
+ * fixed width split at its *s, which are       *
+ * matched left to right without backtracking.  *
+ * A part that is just ** matches any number of *
+ * directories                                  *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#define _GNU_SOURCE // memmem
+#include "../includes/wildcard.h"
+#include "../includes/dirlist.h"
+#include "../includes/tokenizer.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+/* atoms below 256 are that char */
+#define AT_ANY 256
+#define AT_SET 257 // AT_SET + i is sets[i]
+
+typedef struct {
+    short *atoms;
+    char *chars; // atoms as chars, for comparing the plain runs
+    uint64_t (*sets)[4]; // 256 bit char sets for [...]
+    int *chunks; // run i is atoms[chunks[i]] up to chunks[i+1], a * between
+    bool *plain; // run i is only chars
+    int chunk_ct;
+    bool magic; // has anything but chars in it
+    bool dotted; // starts with a ., so it can match hidden names
+} pattern;
+
+enum comp_kind { COMP_PLAIN, COMP_MAGIC, COMP_GLOBSTAR };
+
+/* one /-separated part of the word */
+typedef struct {
+    enum comp_kind kind;
+    char *name; // COMP_PLAIN, without its marks
+    pattern pat; // COMP_MAGIC
+} component;
+
+typedef struct {
+    arena *mem;
+    component *comps;
+    int comp_ct;
+    bool dir_only; // the word ended in /
+    char **matches;
+    int count;
+    int cap;
+    char path[PATH_MAX];
+} walk;
+
+static void compile (const char *, size_t, arena *, pattern *);
+static int parse_set (const char *, int, int, uint64_t *);
+static bool match (const pattern *, const char *, size_t);
+static bool run_at (const pattern *, int, const char *);
+static bool atom_ok (const pattern *, short, unsigned char);
+static void walk_from (walk *, int, size_t);
+static size_t join (walk *, size_t, const char *);
+static void add_match (walk *, size_t);
+
+/**
+ * expands word, in which each unquoted *, ? or [ has a MARK_GLOB
+ * before it, to the paths it matches. They are put in an array in mem,
+ * sorted by name within each directory. Returns how many there are,
+ * 0 if none or if the word has no pattern in it after all
+ */
+int wildcard_expand (const char *word, arena *mem, char ***matches)
+{
+    walk *w = arena_alloc(mem, sizeof(walk));
+    w->mem = mem;
+    w->matches = NULL;
+    w->count = 0;
+    w->cap = 0;
+    w->comp_ct = 0;
+    w->dir_only = false;
+
+    size_t len = strlen(word);
+    size_t plen = 0;
+    if (word[0] == '/') {
+        w->path[plen++] = '/';
+    }
+    if (len > 1 && word[len-1] == '/') {
+        w->dir_only = true;
+    }
+    int parts = 1;
+    for (size_t i = 0; i < len; i++) {
+        parts += (word[i] == '/');
+    }
+    w->comps = arena_alloc(mem, sizeof(component) * parts);
+
+    bool magic = false;
+    for (const char *s = word; s < word + len;) {
+        const char *slash = memchr(s, '/', word + len - s);
+        size_t n = slash ? (size_t)(slash - s) : (size_t)(word + len - s);
+        if (n > 0) { // a//b is a/b
+            component *c = &w->comps[w->comp_ct++];
+            if (n == 4 && s[0] == MARK_GLOB && s[1] == '*' &&
+                s[2] == MARK_GLOB && s[3] == '*') {
+                c->kind = COMP_GLOBSTAR;
+                magic = true;
+            } else {
+                compile(s, n, mem, &c->pat);
+                c->kind = c->pat.magic ? COMP_MAGIC : COMP_PLAIN;
+                magic = magic || c->pat.magic;
+                if (!c->pat.magic) {
+                    c->name = c->pat.chars;
+                }
+            }
+        }
+        s += n + 1;
+    }
+    if (!magic) {
+        return 0;
+    }
+
+    w->path[plen] = '\0';
+    walk_from(w, 0, plen);
+    *matches = w->matches;
+    return w->count;
+}
+
+/**
+ * compiles the n chars of a part at s. A [ without a ] to close it is
+ * an ordinary char
+ */
+static void compile (const char *s, size_t n, arena *mem, pattern *p)
+{
+    int sets = 0;
+    for (size_t i = 0; i + 1 < n; i++) {
+        sets += (s[i] == MARK_GLOB && s[i+1] == '[');
+    }
+    p->atoms = arena_alloc(mem, sizeof(short) * (n + 1));
+    p->chars = arena_alloc(mem, n + 1);
+    p->sets = arena_alloc(mem, sizeof(uint64_t[4]) * (sets + 1));
+    p->chunks = arena_alloc(mem, sizeof(int) * (n + 2));
+    p->plain = arena_alloc(mem, sizeof(bool) * (n + 1));
+    p->magic = false;
+
+    int atom_ct = 0, set_ct = 0;
+    p->chunk_ct = 1;
+    p->chunks[0] = 0;
+    p->plain[0] = true;
+    bool after_star = false;
+    for (int i = 0; i < (int)n; i++) {
+        short atom = (unsigned char)s[i];
+        bool star = false;
+        if (s[i] == MARK_GLOB) {
+            char g = s[++i];
+            atom = (unsigned char)g;
+            if (g == '*') {
+                star = true;
+            } else if (g == '?') {
+                atom = AT_ANY;
+            } else if (g == '[') {
+                int close = parse_set(s, i + 1, n, p->sets[set_ct]);
+                if (close > 0) {
+                    atom = AT_SET + set_ct++;
+                    i = close;
+                }
+            }
+        }
+        if (star) {
+            p->magic = true;
+            if (!after_star) { // ** in a part is *
+                p->chunks[p->chunk_ct] = atom_ct;
+                p->plain[p->chunk_ct++] = true;
+            }
+        } else {
+            if (atom >= AT_ANY) {
+                p->magic = true;
+                p->plain[p->chunk_ct - 1] = false;
+            }
+            p->chars[atom_ct] = (char)atom;
+            p->atoms[atom_ct++] = atom;
+        }
+        after_star = star;
+    }
+    p->chunks[p->chunk_ct] = atom_ct;
+    p->chars[atom_ct] = '\0';
+    p->dotted = atom_ct > 0 && p->chunks[1] > 0 && p->atoms[0] == '.';
+}
+
+/**
+ * fills set from the [...] whose contents start at s[i]. ! or ^ first
+ * negates it, a ] first is a member, a-z is a range. Returns the index
+ * of its ], or 0 if there is none
+ */
+static int parse_set (const char *s, int i, int n, uint64_t *set)
+{
+    memset(set, 0, sizeof(uint64_t[4]));
+    bool negate = false;
+    if (i < n && (s[i] == '!' || s[i] == '^')) {
+        negate = true;
+        i++;
+    }
+    bool first = true;
+    while (i < n) {
+        if (s[i] == MARK_GLOB && i + 1 < n) { // what it marks is a member
+            i++;
+        }
+        if (s[i] == ']' && !first) {
+            if (negate) {
+                for (int k = 0; k < 4; k++) {
+                    set[k] = ~set[k];
+                }
+            }
+            return i;
+        }
+        first = false;
+        unsigned char lo = s[i], hi = lo;
+        if (i + 2 < n && s[i+1] == '-' && s[i+2] != ']') {
+            i += 2;
+            if (s[i] == MARK_GLOB && i + 1 < n) {
+                i++;
+            }
+            hi = s[i];
+        }
+        for (unsigned int c = lo; c <= hi; c++) {
+            set[c >> 6] |= 1UL << (c & 63);
+        }
+        i++;
+    }
+    return 0;
+}
+
+/**
+ * true if the len chars of name match p. The first run has to be at
+ * the start and the last at the end. Each one between is taken where
+ * it first fits, which is always right as the *s around it can take
+ * up whatever is skipped
+ */
+static bool match (const pattern *p, const char *name, size_t len)
+{
+    if (name[0] == '.' && !p->dotted) {
+        return false;
+    }
+    int last = p->chunk_ct - 1;
+    size_t first_len = p->chunks[1] - p->chunks[0];
+    if (last == 0) {
+        return len == first_len && run_at(p, 0, name);
+    }
+    size_t last_len = p->chunks[last + 1] - p->chunks[last];
+    if (len < first_len + last_len || !run_at(p, 0, name) ||
+        !run_at(p, last, name + len - last_len)) {
+        return false;
+    }
+    size_t pos = first_len, end = len - last_len;
+    for (int c = 1; c < last; c++) {
+        size_t n = p->chunks[c + 1] - p->chunks[c];
+        if (n == 0) {
+            continue;
+        }
+        if (p->plain[c]) {
+            const char *at = memmem(name + pos, end - pos,
+                p->chars + p->chunks[c], n);
+            if (at == NULL) {
+                return false;
+            }
+            pos = at - name + n;
+            continue;
+        }
+        while (pos + n <= end && !run_at(p, c, name + pos)) {
+            pos++;
+        }
+        if (pos + n > end) {
+            return false;
+        }
+        pos += n;
+    }
+    return true;
+}
+
+/**
+ * true if run c of p matches the chars at s
+ */
+static bool run_at (const pattern *p, int c, const char *s)
+{
+    int start = p->chunks[c];
+    int n = p->chunks[c + 1] - start;
+    if (p->plain[c]) {
+        return memcmp(s, p->chars + start, n) == 0;
+    }
+    for (int i = 0; i < n; i++) {
+        if (!atom_ok(p, p->atoms[start + i], s[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * true if char c matches atom a of p
+ */
+static bool atom_ok (const pattern *p, short a, unsigned char c)
+{
+    if (a < AT_ANY) {
+        return a == c;
+    } else if (a == AT_ANY) {
+        return true;
+    }
+    return (p->sets[a - AT_SET][c >> 6] >> (c & 63)) & 1;
+}
+
+/**
+ * matches parts i on in the directory whose path is the first plen
+ * chars of w->path, an empty path being the current directory
+ */
+static void walk_from (walk *w, int i, size_t plen)
+{
+    if (i == w->comp_ct) {
+        add_match(w, plen);
+        return;
+    }
+    const component *c = &w->comps[i];
+    bool last = (i == w->comp_ct - 1);
+    if (c->kind == COMP_PLAIN) {
+        size_t len = join(w, plen, c->name);
+        struct stat st;
+        if (len == 0 || (last && lstat(w->path, &st) < 0)) {
+            return;
+        }
+        walk_from(w, i + 1, len);
+        return;
+    }
+
+    w->path[plen] = '\0';
+    const char *dir = plen ? w->path : ".";
+    const dir_list *dl = dir_list_get(dir);
+    if (dl == NULL) {
+        return;
+    }
+    if (c->kind == COMP_GLOBSTAR && !last) {
+        walk_from(w, i + 1, plen); // no directories at all
+    }
+    for (int k = 0; k < dl->count; k++) {
+        const char *name = dl->names + dl->order[k];
+        w->path[plen] = '\0';
+        if (c->kind == COMP_GLOBSTAR) {
+            /* every directory below, never through links, which could
+             * loop. As the last part it is every name below too */
+            if (name[0] == '.') {
+                continue;
+            }
+            bool is_dir = dir_list_is_dir(dl, dir, k, false);
+            size_t len = join(w, plen, name);
+            if (len == 0) {
+                continue;
+            }
+            if (last) {
+                add_match(w, len);
+            }
+            if (is_dir) {
+                walk_from(w, i, len);
+            }
+        } else if (match(&c->pat, name, dl->order[k+1] - dl->order[k] - 1)) {
+            bool descend = !last && dir_list_is_dir(dl, dir, k, true);
+            size_t len = join(w, plen, name);
+            if (len == 0) {
+                continue;
+            }
+            if (last) {
+                add_match(w, len);
+            } else if (descend) {
+                walk_from(w, i + 1, len);
+            }
+        }
+    }
+    dir_list_put(dl);
+}
+
+/**
+ * appends /name to the first plen chars of w->path, without the / if
+ * the path is empty or already ends in one. Returns the new length, or
+ * 0 if it doesn't fit
+ */
+static size_t join (walk *w, size_t plen, const char *name)
+{
+    size_t n = strlen(name);
+    bool slash = plen > 0 && w->path[plen-1] != '/';
+    if (plen + slash + n >= sizeof(w->path)) {
+        return 0;
+    }
+    if (slash) {
+        w->path[plen++] = '/';
+    }
+    memcpy(w->path + plen, name, n + 1);
+    return plen + n;
+}
+
+/**
+ * adds the first plen chars of w->path to the matches, with a / after
+ * it if the word ended in one, which only directories match
+ */
+static void add_match (walk *w, size_t plen)
+{
+    w->path[plen] = '\0';
+    if (w->dir_only) {
+        struct stat st;
+        if (stat(w->path, &st) < 0 || !S_ISDIR(st.st_mode)) {
+            return;
+        }
+    }
+    if (w->count == w->cap) { // grow the array inside the arena
+        int cap = w->cap ? w->cap * 2 : 16;
+        char **matches = arena_alloc(w->mem, sizeof(char *) * cap);
+        if (w->count) {
+            memcpy(matches, w->matches, sizeof(char *) * w->count);
+        }
+        w->matches = matches;
+        w->cap = cap;
+    }
+    char *path = arena_alloc(w->mem, plen + w->dir_only + 1);
+    memcpy(path, w->path, plen);
+    if (w->dir_only) {
+        path[plen++] = '/';
+    }
+    path[plen] = '\0';
+    w->matches[w->count++] = path;
+}
@@ -5,66 +5,154 @@
  * Reads a .myclirc file from the user's home   *
  * directory and execs it line by line if it is *
  * executable, then waits for user input to     *
- * tokenize and run commands                    *
+ * tokenize and run commands, which it keeps a  *
+ * history of. Given a file, or a file on       *
+ * stdin, it runs that as a script              *
  ************************************************
  * Author: Justin Weigle                        *
- * Edited: 30 Jul 2020                          *
+ * Edited: 16 Oct 2026                          *
  ************************************************/
 
 #include "includes/mycli.h"
-#include "includes/tokenizer.h"
-#include "includes/executor.h"
-#include "includes/internal.h"
+#include "includes/dispatch.h"
 #include "includes/rcreader.h"
+#include "includes/linereader.h"
+#include "includes/script.h"
+#include "includes/jobs.h"
+#include "includes/trace.h"
+#include "includes/vars.h"
+#include "includes/history.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+static ssize_t prompted_line (void *, char **);
+static char *recall (const char *, size_t);
 
 int main (int argc, char **argv)
 {
     signal(SIGINT, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN); // so the shell can take the terminal back
 
-    read_myclirc();
-
-    ListHandler tlist;
-    tlist.head = NULL;
-    tlist.tail = NULL;
-    tlist.count = 0;
-
-    char userin[BUFF_SIZE];
-    while (!feof(stdin)) {
-        char *PS1 = getenv("PS1");
-        if (PS1 == NULL) {
-            printf("$ ");
-        } else {
-            printf("%s", PS1);
-        }
-        if (fgets(userin, BUFF_SIZE, stdin) == NULL) {
-            perror("failed to get user input");
-            exit(0);
+    int fd = STDIN_FILENO;
+    if (argc > 1) { // mycli script
+        fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            perror(argv[1]);
+            return 127;
         }
+    }
+    bool interactive = (fd == STDIN_FILENO && isatty(fd));
+    if (interactive) { // ^Z and background reads are for the jobs
+        signal(SIGTSTP, SIG_IGN);
+        signal(SIGTTIN, SIG_IGN);
+    }
+    jobs_init(interactive);
+    trace_init();
+
+    read_myclirc();
 
-        /* get tokenized input */
-        tokenize(&tlist, userin);
+    /* scripts are mapped and run in place when they can be, pipes and
+     * terminals go through the line reader */
+    if (!interactive && run_script(fd) == 0) {
+        return 0;
+    }
 
-        /* print the tokenized input */
-//        print_tokens(tlist.head);
+    line_reader in;
+    reader_init(&in, fd);
+    if (interactive) { // reap background jobs while waiting for input
+        reader_set_wake(&in, jobs_fd(), jobs_signalled);
+    }
 
-        /* exec tokenized input */
-        if (tlist.head) {
-            int ret = run_internal_cmd(tlist);
-            if (ret < 0) {
-                fprintf(stderr,"Unable to run internal command\n");
-            } else if (ret == 0) {
+    char *userin;
+    ssize_t length;
+    for (;;) {
+        if (interactive) {
+            jobs_update();
+            jobs_notify();
+            const char *PS1 = var_get("PS1");
+            if (PS1 == NULL) {
+                printf("$ ");
             } else {
-                execute(tlist.head);
+                printf("%s", PS1);
             }
+            fflush(stdout); // stdin is read with read(), stdio won't flush
+        }
+        uint64_t t = trace_start();
+        length = read_line(&in, &userin);
+        trace_stop(PH_READ, t);
+        if (length < 0) {
+            break;
         }
 
-        /* free the tokenized input */
-        free_tok_list(&tlist);
+        if (!interactive) {
+            /* tokenize and run the input */
+            run_line(userin, length, reader_next_line, &in);
+            continue;
+        }
+        char *recalled = NULL;
+        /* a ! on its own is left for the command to have */
+        if (userin[0] == '!' && strchr(" \t\n", userin[1]) == NULL) {
+            recalled = recall(userin, length);
+            if (recalled == NULL) {
+                continue;
+            }
+            userin = recalled;
+            length = strlen(recalled);
+        }
+        history_start(userin, length);
+        run_line(userin, length, prompted_line, &in);
+        history_finish(last_status());
+        free(recalled);
     }
+    reader_free(&in);
 
     return 0;
 }
+
+/**
+ * reads the next line of a here document from the terminal, prompting
+ * for it with PS2
+ */
+static ssize_t prompted_line (void *in, char **line)
+{
+    const char *PS2 = var_get("PS2");
+    printf("%s", PS2 == NULL ? "> " : PS2);
+    fflush(stdout);
+    return read_line(in, line);
+}
+
+/**
+ * !! is the last line typed and !prefix the last one that started with
+ * prefix, followed by the rest of the line. line has at least one char
+ * after the ! before any blank. Returns the line it stands for with its
+ * \n, echoed so it can be seen, or NULL if there is none
+ */
+static char *recall (const char *line, size_t len)
+{
+    size_t n = strcspn(line + 1, " \t\n");
+    const char *rest = line + 1 + n;
+    size_t found_len;
+    const char *found = (n == 1 && line[1] == '!') ?
+        history_recall("", 0, &found_len) :
+        history_recall(line + 1, n, &found_len);
+    if (found == NULL) {
+        fprintf(stderr, "%.*s: event not found\n", (int)(n + 1), line);
+        return NULL;
+    }
+    size_t rest_len = line + len - rest;
+    char *cmd = malloc(found_len + rest_len + 1);
+    if (cmd == NULL) {
+        perror("malloc failed in recall");
+        exit(-1);
+    }
+    memcpy(cmd, found, found_len);
+    memcpy(cmd + found_len, rest, rest_len);
+    cmd[found_len + rest_len] = '\0';
+    printf("%s", cmd);
+    return cmd;
+}
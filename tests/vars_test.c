@@ -0,0 +1,90 @@
+/************************************************
+ *                 vars_test.c                  *
+ ************************************************
+ * Checks that variables which were unset, or   *
+ * never set, read back as unset and can be     *
+ * unset and exported without harm              *
+ ************************************************
+ * Author: Justin Weigle                        *
+ * Edited: 16 Oct 2026                          *
+ ************************************************/
+
+#include "../includes/vars.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check (bool, const char *, int);
+static bool in_envp (const char *);
+
+int main ()
+{
+    /* unset then get */
+    CHECK(var_set("FOO", "1", false));
+    CHECK(!strcmp(var_get("FOO"), "1"));
+    var_unset("FOO");
+    CHECK(var_get("FOO") == NULL);
+
+    /* a name that probes past FOO's tombstone */
+    CHECK(var_get("MYCLI_NEVER_SET") == NULL);
+
+    /* unset of a missing name, and of one already unset */
+    var_unset("MYCLI_NEVER_SET");
+    var_unset("FOO");
+    CHECK(var_get("FOO") == NULL);
+
+    /* export of a missing name */
+    CHECK(!var_export("MYCLI_NEVER_SET"));
+    CHECK(!var_export("FOO"));
+    CHECK(!in_envp("FOO="));
+
+    /* set again where the tombstone is */
+    CHECK(var_set("FOO", "2", true));
+    CHECK(!strcmp(var_get("FOO"), "2"));
+    CHECK(in_envp("FOO=2"));
+    var_unset("FOO");
+    CHECK(var_get("FOO") == NULL);
+    CHECK(!in_envp("FOO="));
+
+    /* many tombstones, through rehashes */
+    char name[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "V%d", i);
+        var_set(name, "x", i % 2);
+        var_unset(name);
+    }
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "V%d", i);
+        CHECK(var_get(name) == NULL);
+    }
+
+    printf("vars_test: %s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
+
+/**
+ * counts and reports a check that didn't hold
+ */
+static void check (bool ok, const char *what, int line)
+{
+    if (!ok) {
+        fprintf(stderr, "vars_test.c:%d: %s\n", line, what);
+        failures++;
+    }
+}
+
+/**
+ * true if an envp entry starts with prefix
+ */
+static bool in_envp (const char *prefix)
+{
+    for (char **e = var_envp(); *e != NULL; e++) {
+        if (!strncmp(*e, prefix, strlen(prefix))) {
+            return true;
+        }
+    }
+    return false;
+}